@@ -0,0 +1,507 @@
+#include "genId.hpp"
+
+#include "lits/lits.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#define RESET "\033[0m"
+#define GREEN "\033[32m"
+#define YELLOW "\033[33m"
+
+const int default_key_cnt = 2e6;
+const int default_search_cnt = 1e6;
+const int default_scan_cnt = 1e5;
+const int default_scan_range = 100;
+
+// The keys (shuffled), the first half is bulk loaded, the rest inserted
+std::vector<std::string> keys;
+std::vector<uint64_t> key_vals;
+
+// The sorted bulk load keys and values
+std::vector<const char *> bulk_keys;
+std::vector<uint64_t> bulk_vals;
+
+// The queries, as pointers into keys
+std::vector<const char *> search_keys;
+std::vector<const char *> insert_keys;
+std::vector<const char *> scan_keys;
+std::vector<int> scan_ranges;
+
+/**
+ * LITS.
+ */
+class LitsBench {
+  private:
+    lits::LITS index;
+
+  public:
+    static const char *name() { return "LITS"; }
+
+    bool bulkload(const char **_keys, const uint64_t *_vals, const int _len) {
+        return index.bulkload(_keys, _vals, _len);
+    }
+
+    bool lookup(const char *_key, uint64_t &_val) {
+        lits::kv *res = index.lookup(_key);
+        if (res == NULL)
+            return false;
+        _val = res->read();
+        return true;
+    }
+
+    bool insert(const char *_key, const uint64_t _val) {
+        return index.insert(_key, _val);
+    }
+
+    uint64_t scan(const char *_key, const int cnt) {
+        uint64_t sum = 0;
+        auto iter = index.find(_key);
+        for (int i = 0; i < cnt && iter.not_finish(); ++i) {
+            sum += iter.getKV()->read();
+            iter.next();
+        }
+        return sum;
+    }
+
+    uint64_t memory_usage() const { return index.memory_usage(); }
+
+    void destroy() { index.destroy(); }
+};
+
+/**
+ * A standalone HOT, storing the same kv entries as LITS does.
+ */
+class HotBench {
+  private:
+    lits::HOTIndex index;
+
+    // HOT's node pool and the kv entries, charged while this index runs
+    lits::Counters counters;
+
+  public:
+    static const char *name() { return "HOT"; }
+
+    bool bulkload(const char **_keys, const uint64_t *_vals, const int _len) {
+        lits::CountersScope scope(&counters);
+        for (int i = 0; i < _len; ++i) {
+            lits::HOTInsert(index, (const lits::str)_keys[i], _vals[i]);
+        }
+        return true;
+    }
+
+    bool lookup(const char *_key, uint64_t &_val) {
+        lits::kv *res = lits::HOTLookup(index, (const lits::str)_key);
+        if (res == NULL)
+            return false;
+        _val = res->read();
+        return true;
+    }
+
+    bool insert(const char *_key, const uint64_t _val) {
+        lits::CountersScope scope(&counters);
+        lits::kv *_kv = lits::new_kv((const lits::str)_key, _val);
+        if (!lits::HOTInsert(index, _kv)) {
+            lits::free_kv(_kv);
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t scan(const char *_key, const int cnt) {
+        uint64_t sum = 0;
+        auto iter = index.lower_bound(_key);
+        for (int i = 0; i < cnt && iter != lits::HOTIndex::END_ITERATOR;
+             ++i, ++iter) {
+            sum += (*iter).read();
+        }
+        return sum;
+    }
+
+    uint64_t memory_usage() const {
+        return sizeof(index) + counters.hot_bytes + counters.kv_bytes;
+    }
+
+    void destroy() {
+        lits::CountersScope scope(&counters);
+        std::vector<lits::kv *> kvs;
+        for (auto it = index.begin(); it != lits::HOTIndex::END_ITERATOR; ++it)
+            kvs.push_back((*it).getKV());
+        index.~HOTSingleThreaded();
+        new (&index) lits::HOTIndex();
+        for (lits::kv *_kv : kvs)
+            lits::free_kv(_kv);
+    }
+};
+
+/**
+ * An allocator counting the bytes it holds, for the node based baselines.
+ */
+template <class T> class CountingAllocator {
+  public:
+    typedef T value_type;
+
+    uint64_t *bytes;
+
+    CountingAllocator(uint64_t *_bytes) : bytes(_bytes) {}
+    template <class U>
+    CountingAllocator(const CountingAllocator<U> &o) : bytes(o.bytes) {}
+
+    T *allocate(std::size_t n) {
+        *bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        *bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <class U> bool operator==(const CountingAllocator<U> &o) const {
+        return bytes == o.bytes;
+    }
+    template <class U> bool operator!=(const CountingAllocator<U> &o) const {
+        return bytes != o.bytes;
+    }
+};
+
+/**
+ * std::map<std::string, uint64_t>. The memory usage counts the tree nodes and
+ * the key bytes std::string keeps out of line.
+ */
+class MapBench {
+  private:
+    typedef std::pair<const std::string, uint64_t> entry;
+    typedef std::map<std::string, uint64_t, std::less<>,
+                     CountingAllocator<entry>>
+        map_type;
+
+    uint64_t node_bytes = 0, heap_key_bytes = 0;
+    map_type index{CountingAllocator<entry>(&node_bytes)};
+
+    // The bytes a key keeps out of the node (0 under the short string buffer)
+    static uint64_t heapBytes(const std::string &s) {
+        return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+    }
+
+  public:
+    static const char *name() { return "std::map"; }
+
+    bool bulkload(const char **_keys, const uint64_t *_vals, const int _len) {
+        for (int i = 0; i < _len; ++i) {
+            auto it = index.emplace_hint(index.end(), _keys[i], _vals[i]);
+            heap_key_bytes += heapBytes(it->first);
+        }
+        return true;
+    }
+
+    bool lookup(const char *_key, uint64_t &_val) {
+        auto it = index.find(_key);
+        if (it == index.end())
+            return false;
+        _val = it->second;
+        return true;
+    }
+
+    bool insert(const char *_key, const uint64_t _val) {
+        auto res = index.emplace(_key, _val);
+        if (res.second)
+            heap_key_bytes += heapBytes(res.first->first);
+        return res.second;
+    }
+
+    uint64_t scan(const char *_key, const int cnt) {
+        uint64_t sum = 0;
+        auto it = index.lower_bound(_key);
+        for (int i = 0; i < cnt && it != index.end(); ++i, ++it) {
+            sum += it->second;
+        }
+        return sum;
+    }
+
+    uint64_t memory_usage() const {
+        return sizeof(index) + node_bytes + heap_key_bytes;
+    }
+
+    void destroy() {
+        index.clear();
+        heap_key_bytes = 0;
+    }
+};
+
+/**
+ * A read-only sorted array searched by binary search: the keys packed in one
+ * buffer, an array of key offsets and an array of values.
+ */
+class ArrayBench {
+  private:
+    std::vector<char> data;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> vals;
+
+    // The position of the first key not less than _key
+    int lower_bound(const char *_key) const {
+        int l = 0, r = offsets.size();
+        while (l < r) {
+            int m = (l + r) / 2;
+            if (strcmp(&data[offsets[m]], _key) < 0)
+                l = m + 1;
+            else
+                r = m;
+        }
+        return l;
+    }
+
+  public:
+    static const char *name() { return "SortedArray"; }
+
+    bool bulkload(const char **_keys, const uint64_t *_vals, const int _len) {
+        uint64_t bytes = 0;
+        for (int i = 0; i < _len; ++i)
+            bytes += strlen(_keys[i]) + 1;
+        data.resize(bytes);
+        offsets.resize(_len);
+        vals.assign(_vals, _vals + _len);
+        for (int i = 0, ofs = 0; i < _len; ++i) {
+            int len = strlen(_keys[i]) + 1;
+            memcpy(&data[ofs], _keys[i], len);
+            offsets[i] = ofs;
+            ofs += len;
+        }
+        return true;
+    }
+
+    bool lookup(const char *_key, uint64_t &_val) {
+        int pos = lower_bound(_key);
+        if (pos == offsets.size() || strcmp(&data[offsets[pos]], _key) != 0)
+            return false;
+        _val = vals[pos];
+        return true;
+    }
+
+    // Inserting shifts half the array on average, so it is not measured
+    bool insert(const char *_key, const uint64_t _val) { return false; }
+    static bool writable() { return false; }
+
+    uint64_t scan(const char *_key, const int cnt) {
+        uint64_t sum = 0;
+        int pos = lower_bound(_key);
+        for (int i = 0; i < cnt && pos < vals.size(); ++i, ++pos) {
+            sum += vals[pos];
+        }
+        return sum;
+    }
+
+    uint64_t memory_usage() const {
+        return data.capacity() + offsets.capacity() * sizeof(uint64_t) +
+               vals.capacity() * sizeof(uint64_t);
+    }
+
+    void destroy() {
+        std::vector<char>().swap(data);
+        std::vector<uint64_t>().swap(offsets);
+        std::vector<uint64_t>().swap(vals);
+    }
+};
+
+// Every index but the sorted array takes inserts
+template <class Index> bool isWritable() { return true; }
+template <> bool isWritable<ArrayBench>() { return ArrayBench::writable(); }
+
+/**
+ * The measurements of one operation type.
+ */
+class OpResult {
+  public:
+    bool measured = false;
+    uint64_t ops = 0;
+    uint64_t checksum = 0;
+    double seconds = 0;
+    lits::Histogram latency; // in ticks
+
+    double mops() const { return ops / (1e6 * seconds); }
+};
+
+/**
+ * The measurements of one index.
+ */
+class Result {
+  public:
+    const char *name;
+    double bulkload_seconds = 0;
+    double bulk_bytes_per_key = 0;
+    double final_bytes_per_key = 0;
+    OpResult search, insert, scan;
+};
+
+/**
+ * Time f on every query, recording the latency of each one.
+ */
+template <class F>
+void runOps(OpResult &res, const std::vector<const char *> &queries, F f) {
+    res.measured = true;
+    res.ops = queries.size();
+    double t0 = lits::nowSec();
+    for (int i = 0; i < queries.size(); ++i) {
+        uint64_t c0 = lits::rdtsc();
+        res.checksum += f(i, queries[i]);
+        res.latency.record(lits::rdtsc() - c0);
+    }
+    res.seconds = lits::nowSec() - t0;
+}
+
+template <class Index> Result runIndex() {
+    Result res;
+    res.name = Index::name();
+
+    std::cout << "[Info]: Running " << res.name << " ..." << std::endl;
+
+    std::unique_ptr<Index> index(new Index());
+
+    double t0 = lits::nowSec();
+    if (!index->bulkload(bulk_keys.data(), bulk_vals.data(),
+                         bulk_keys.size())) {
+        std::cerr << "[Error]: " << res.name << " failed to bulk load"
+                  << std::endl;
+        return res;
+    }
+    res.bulkload_seconds = lits::nowSec() - t0;
+    res.bulk_bytes_per_key = (double)index->memory_usage() / bulk_keys.size();
+
+    runOps(res.search, search_keys, [&](int i, const char *key) {
+        uint64_t v = 0;
+        return index->lookup(key, v) ? v : 0;
+    });
+
+    uint64_t num_keys = bulk_keys.size();
+    if (isWritable<Index>()) {
+        runOps(res.insert, insert_keys, [&](int i, const char *key) {
+            return index->insert(key, i + 1) ? 1 : 0;
+        });
+        num_keys += res.insert.checksum;
+    }
+
+    runOps(res.scan, scan_keys, [&](int i, const char *key) {
+        return index->scan(key, scan_ranges[i]);
+    });
+
+    res.final_bytes_per_key = (double)index->memory_usage() / num_keys;
+
+    index->destroy();
+    return res;
+}
+
+bool prepareQueries(const char *name, int cnt) {
+    if (!loadDataset(name, cnt, keys, key_vals))
+        return false;
+    KeyStats(keys).print();
+
+    std::mt19937_64 gen(1);
+    std::vector<int> perm(keys.size());
+    for (int i = 0; i < perm.size(); ++i)
+        perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), gen);
+
+    // Bulk load half of the keys, sorted, and insert the other half
+    int num_of_bulk = keys.size() / 2;
+    std::vector<int> bulk(perm.begin(), perm.begin() + num_of_bulk);
+    std::sort(bulk.begin(), bulk.end());
+    for (int i : bulk) {
+        bulk_keys.push_back(keys[i].c_str());
+        bulk_vals.push_back(key_vals.empty() ? i + 1 : key_vals[i]);
+    }
+    for (int i = num_of_bulk; i < perm.size(); ++i) {
+        insert_keys.push_back(keys[perm[i]].c_str());
+    }
+
+    // Search and scan the bulk loaded keys
+    std::uniform_int_distribution<int> pick(0, num_of_bulk - 1);
+    for (int i = 0; i < default_search_cnt; ++i) {
+        search_keys.push_back(bulk_keys[pick(gen)]);
+    }
+    for (int i = 0; i < default_scan_cnt; ++i) {
+        scan_keys.push_back(bulk_keys[pick(gen)]);
+        scan_ranges.push_back(gen() % default_scan_range + 1);
+    }
+    return true;
+}
+
+void OutputResults(const std::vector<Result> &results) {
+    double tpn = lits::ticksPerNs();
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(2);
+
+    std::cout << std::endl
+              << YELLOW << "[Bulk Load] (" << bulk_keys.size() << " keys)"
+              << RESET << std::endl;
+    for (const Result &r : results) {
+        std::cout << std::left << std::setw(12) << r.name << std::right
+                  << " time " << std::setw(7) << r.bulkload_seconds * 1e3
+                  << " ms, " << std::setw(6) << r.bulk_bytes_per_key
+                  << " bytes/key after bulk load, " << std::setw(6)
+                  << r.final_bytes_per_key << " bytes/key at the end"
+                  << std::endl;
+    }
+
+    const char *op_names[] = {"Search", "Insert", "Scan"};
+    for (int op = 0; op < 3; ++op) {
+        std::cout << std::endl
+                  << YELLOW << "[" << op_names[op] << "]" << RESET
+                  << std::endl;
+        for (const Result &r : results) {
+            const OpResult &o =
+                op == 0 ? r.search : (op == 1 ? r.insert : r.scan);
+            std::cout << std::left << std::setw(12) << r.name << std::right;
+            if (!o.measured) {
+                std::cout << " not supported" << std::endl;
+                continue;
+            }
+            std::cout << " " << GREEN << std::setw(7) << o.mops() << " Mops"
+                      << RESET << ", p50 " << o.latency.percentile(0.5) / tpn
+                      << ", p99 " << o.latency.percentile(0.99) / tpn
+                      << ", p99.9 " << o.latency.percentile(0.999) / tpn
+                      << " ns (checksum " << o.checksum << ")" << std::endl;
+        }
+    }
+    std::cout.flags(flags);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cout << "Usage: " << std::endl;
+        std::cout << argv[0]
+                  << " idcards/randstr/url/email/path/uuid/dna/file:<path> "
+                     "[num_keys]"
+                  << std::endl;
+        return 0;
+    }
+
+    int cnt = argc == 3 ? atoi(argv[2]) : default_key_cnt;
+    if (cnt < 2000 || !prepareQueries(argv[1], cnt)) {
+        std::cout << "Invalid argument" << std::endl;
+        return 0;
+    }
+
+    std::cout << std::endl
+              << YELLOW << "[Comparative Test] (50% bulk load, "
+              << search_keys.size() << " search, " << insert_keys.size()
+              << " insert, " << scan_keys.size() << " scan)" << RESET
+              << std::endl;
+
+    // Calibrate before the first run
+    lits::ticksPerNs();
+
+    std::vector<Result> results;
+    results.push_back(runIndex<LitsBench>());
+    results.push_back(runIndex<HotBench>());
+    results.push_back(runIndex<MapBench>());
+    results.push_back(runIndex<ArrayBench>());
+
+    OutputResults(results);
+}
@@ -152,6 +152,15 @@ void exampleMain() {
         std::cout << RED << "not found" << RESET << std::endl;
     }
 
+    //=====[Example 8: Insert with a hint]==================================
+    std::string word4 = word3 + "ship";
+    std::cout << "[Example 8][Insert Hint]: Try to insert (" << YELLOW
+              << word4 << RESET << ", " << BLUE << value1 << RESET
+              << ") next to (" << YELLOW << word3 << RESET << ") ... ";
+    auto hint = index.find(word3.c_str());
+    auto result8 = index.insert_hint(hint, word4.c_str(), value1);
+    std::cout << GREEN << (result8 ? "success" : "fail") << RESET << std::endl;
+
     index.destroy();
 }
 
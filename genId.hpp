@@ -1,6 +1,10 @@
 #pragma once
 
+#include "lits/lits_gpkl.hpp"
+#include "lits/lits_pmss.hpp"
+
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <set>
@@ -21,6 +25,184 @@ bool sortedAndUnique(const std::vector<std::string> &keys) {
     return true;
 }
 
+// The key types which can be generated, and the files caching them
+const int KeyTypeCnt = 7;
+const char *key_type_names[KeyTypeCnt] = {"idcards", "randstr", "url", "email",
+                                          "path",    "uuid",    "dna"};
+const char *key_type_files[KeyTypeCnt] = {
+    "Idcards.txt", "Randstr.txt", "Urls.txt", "Emails.txt",
+    "Paths.txt",   "Uuids.txt",   "Kmers.txt"};
+
+/**
+ * Return the key type of the name, -1 if unknown.
+ */
+int keyTypeOf(const std::string &name) {
+    for (int i = 0; i < KeyTypeCnt; ++i) {
+        if (name == key_type_names[i])
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Generators of realistic string keys: most keys share a few popular
+ * prefixes (schemes, hosts, directories), and differ in a long tail.
+ */
+class KeyGenerator {
+  private:
+    static const int WordCnt = 1000;
+    static const int DomainCnt = 2000;
+    static const int UserCnt = 50;
+    static const int KmerLen = 31;
+
+    /**
+     * Return a skewed index in [0, n): small indexes are much more popular.
+     */
+    static int skewed(int n) {
+        double u = (double)rand() / ((double)RAND_MAX + 1);
+        return (int)(n * u * u * u);
+    }
+
+    /**
+     * Return the vocabulary of pronounceable words, made once.
+     */
+    static const std::vector<std::string> &words() {
+        static std::vector<std::string> vocab;
+        if (vocab.empty()) {
+            const char *cons = "bcdfghklmnprstvwz";
+            const char *vows = "aeiou";
+            std::set<std::string> seen;
+            while (seen.size() < WordCnt) {
+                std::string w;
+                int syllables = rand() % 3 + 1;
+                for (int i = 0; i < syllables; ++i) {
+                    w.push_back(cons[rand() % 17]);
+                    w.push_back(vows[rand() % 5]);
+                    if (rand() % 3 == 0)
+                        w.push_back(cons[rand() % 17]);
+                }
+                seen.insert(w);
+            }
+            vocab.assign(seen.begin(), seen.end());
+            std::random_shuffle(vocab.begin(), vocab.end());
+        }
+        return vocab;
+    }
+
+    static const std::string &word(int i) { return words()[i % WordCnt]; }
+
+    static std::string domain(int i) {
+        static const char *tlds[] = {".com", ".org", ".net", ".io",
+                                     ".cn",  ".de",  ".co.uk"};
+        return word(i) + word(i * 7 + 3) + tlds[i % 7];
+    }
+
+    /**
+     * Return a genome of the given length, with repeated regions.
+     */
+    static const std::string &genome(size_t len) {
+        static std::string g;
+        if (g.size() < len) {
+            const char *bases = "ACGT";
+            g.clear();
+            while (g.size() < len) {
+                // One tenth of the genome repeats an earlier region
+                if (g.size() > 1000 && rand() % 10 == 0) {
+                    size_t from = rand() % (g.size() - 500);
+                    g.append(g, from, 100 + rand() % 400);
+                } else {
+                    for (int i = 0; i < 500; ++i)
+                        g.push_back(bases[rand() % 4]);
+                }
+            }
+        }
+        return g;
+    }
+
+  public:
+    // https://www.<host>/<segments>[.html][?id=<n>]
+    static std::string getUrl() {
+        std::string ret = rand() % 10 ? "https://" : "http://";
+        if (rand() % 4)
+            ret += "www.";
+        ret += domain(skewed(DomainCnt));
+        int segments = rand() % 4 + 1;
+        for (int i = 0; i < segments; ++i) {
+            ret += "/" + word(skewed(WordCnt));
+        }
+        if (rand() % 2)
+            ret += ".html";
+        if (rand() % 3 == 0)
+            ret += "?id=" + std::to_string(rand() % 100000);
+        return ret;
+    }
+
+    // <first>.<last>[<n>]@<provider or company>
+    static std::string getEmail() {
+        static const char *providers[] = {"gmail.com",   "yahoo.com",
+                                          "outlook.com", "qq.com",
+                                          "163.com",     "icloud.com"};
+        std::string ret = word(rand() % WordCnt);
+        if (rand() % 2)
+            ret += "." + word(rand() % WordCnt);
+        if (rand() % 2)
+            ret += std::to_string(rand() % 1000);
+        ret += "@";
+        if (rand() % 3)
+            ret += providers[skewed(6)];
+        else
+            ret += domain(skewed(DomainCnt));
+        return ret;
+    }
+
+    // /home/<user>/<dirs>/<file>.<ext> or a system directory
+    static std::string getPath() {
+        static const char *roots[] = {"/usr/lib/", "/usr/share/", "/var/log/",
+                                      "/opt/", "/etc/"};
+        static const char *exts[] = {".c",   ".h",    ".cpp", ".py", ".txt",
+                                     ".log", ".json", ".so",  ".md"};
+        std::string ret;
+        if (rand() % 4) {
+            ret = "/home/" + word(skewed(UserCnt)) + "/";
+        } else {
+            ret = roots[skewed(5)];
+        }
+        // Deeper levels have more choices
+        int depth = rand() % 6 + 1;
+        for (int i = 0; i < depth; ++i) {
+            ret += word(skewed(8 << (2 * i))) + "/";
+        }
+        ret += word(rand() % WordCnt);
+        if (rand() % 3 == 0)
+            ret += "_" + std::to_string(rand() % 100);
+        ret += exts[skewed(9)];
+        return ret;
+    }
+
+    // Random (version 4) UUID in lower-case hex
+    static std::string getUuid() {
+        const char *hex = "0123456789abcdef";
+        std::string ret;
+        for (int i = 0; i < 32; ++i) {
+            int d = rand() % 16;
+            if (i == 12)
+                d = 4;
+            if (i == 16)
+                d = 8 + rand() % 4;
+            if (i == 8 || i == 12 || i == 16 || i == 20)
+                ret.push_back('-');
+            ret.push_back(hex[d]);
+        }
+        return ret;
+    }
+
+    // A k-mer sampled from a genome with repeats
+    static std::string getKmer(size_t genome_len) {
+        const std::string &g = genome(genome_len);
+        return g.substr(rand() % (g.size() - KmerLen), KmerLen);
+    }
+};
+
 class IdGenerator {
   private:
     static const int ProvinceCodeCnt = 34;
@@ -109,10 +291,32 @@ class IdGenerator {
         return ret;
     }
 
+    /**
+     * Return a key of the type (see key_type_names).
+     */
+    static std::string getKey(int type, int cnt) {
+        switch (type) {
+        case 0:
+            return getId();
+        case 1:
+            return getRandstr();
+        case 2:
+            return KeyGenerator::getUrl();
+        case 3:
+            return KeyGenerator::getEmail();
+        case 4:
+            return KeyGenerator::getPath();
+        case 5:
+            return KeyGenerator::getUuid();
+        default:
+            return KeyGenerator::getKmer((size_t)cnt * 2);
+        }
+    }
+
     static std::vector<std::string> getKeys(int cnt, int type) {
 
-        // The target file: Idcards.txt
-        std::string filename = type == 0 ? "Idcards.txt" : "Randstr.txt";
+        // The target file, e.g. Idcards.txt
+        std::string filename = key_type_files[type];
 
         // Return Idcards
         std::vector<std::string> ids;
@@ -133,7 +337,7 @@ class IdGenerator {
             // Generate ids and store them in Idcards.txts
             std::set<std::string> idSet;
             while (idSet.size() < cnt) {
-                std::string id = type == 0 ? getId() : getRandstr();
+                std::string id = getKey(type, cnt);
                 idSet.insert(id);
             }
             ids.assign(idSet.begin(), idSet.end());
@@ -158,6 +362,229 @@ class IdGenerator {
     }
 };
 
+/**
+ * Load the keys of a file, one per line. A line may carry a value after a
+ * tab. The keys are sorted and deduplicated (the first value wins), keys LITS
+ * cannot index (empty, or with non-ASCII bytes) are skipped. vals is left
+ * empty if no line carries a value.
+ */
+bool loadKeyFile(const std::string &filename, std::vector<std::string> &keys,
+                 std::vector<uint64_t> &vals) {
+    std::ifstream infile(filename);
+    if (!infile.good()) {
+        std::cerr << "Unable to open file: " << filename << std::endl;
+        return false;
+    }
+    std::cout << "Reading keys from " << filename << " ... " << std::endl;
+
+    std::vector<std::pair<std::string, uint64_t>> kvs;
+    std::string line;
+    bool hasVals = false;
+    uint64_t skipped = 0;
+    while (std::getline(infile, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        uint64_t v = kvs.size() + 1;
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos) {
+            v = strtoull(line.c_str() + tab + 1, NULL, 10);
+            line.resize(tab);
+            hasVals = true;
+        }
+        bool valid = !line.empty();
+        for (unsigned char c : line)
+            valid = valid && c < 128;
+        if (!valid) {
+            skipped++;
+            continue;
+        }
+        kvs.emplace_back(line, v);
+    }
+
+    std::stable_sort(kvs.begin(), kvs.end(),
+                     [](const std::pair<std::string, uint64_t> &a,
+                        const std::pair<std::string, uint64_t> &b) {
+                         return a.first < b.first;
+                     });
+    keys.clear();
+    vals.clear();
+    for (int i = 0; i < kvs.size(); ++i) {
+        if (i > 0 && kvs[i].first == kvs[i - 1].first)
+            continue;
+        keys.push_back(kvs[i].first);
+        if (hasVals)
+            vals.push_back(kvs[i].second);
+    }
+
+    if (skipped)
+        std::cout << "Skipped " << skipped << " invalid keys." << std::endl;
+    std::cout << keys.size() << " unique keys read." << std::endl;
+    return !keys.empty();
+}
+
+/**
+ * Load a dataset by name: one of key_type_names (generated, cnt keys), or
+ * "file:<path>" for a key file.
+ */
+bool loadDataset(const std::string &name, int cnt,
+                 std::vector<std::string> &keys,
+                 std::vector<uint64_t> &vals) {
+    if (name.compare(0, 5, "file:") == 0)
+        return loadKeyFile(name.substr(5), keys, vals);
+
+    int type = keyTypeOf(name);
+    if (type < 0) {
+        std::cerr << "Invalid dataset: " << name << std::endl;
+        return false;
+    }
+    keys = IdGenerator::getKeys(cnt, type);
+    vals.clear();
+    return true;
+}
+
+/**
+ * Key length and LCP distributions of a sorted and unique key set, and the
+ * structure PMSS would choose for the root.
+ */
+class KeyStats {
+  public:
+    uint64_t cnt = 0;
+    int alphabet = 0;
+
+    // Key length
+    double len_avg = 0;
+    int len_min = 0, len_p50 = 0, len_p99 = 0, len_max = 0;
+
+    // Common prefix length of adjacent keys
+    double lcp_avg = 0;
+    int lcp_p50 = 0, lcp_p99 = 0, lcp_max = 0;
+
+    // Global partial key length, and the root structure
+    double gpkl = 0;
+    lits::SubTrieType root_type = lits::STYP_Cnode;
+
+  public:
+    KeyStats(const std::vector<std::string> &keys) {
+        cnt = keys.size();
+        if (cnt < 2)
+            return;
+
+        std::vector<int> lens(cnt);
+        std::vector<const char *> ptrs(cnt);
+        bool used[256] = {false};
+        for (int i = 0; i < cnt; ++i) {
+            lens[i] = keys[i].length();
+            ptrs[i] = keys[i].c_str();
+            len_avg += lens[i];
+            for (unsigned char c : keys[i])
+                used[c] = true;
+        }
+        len_avg /= cnt;
+        for (int c = 0; c < 256; ++c)
+            alphabet += used[c];
+
+        lits::AdjLCP adj;
+        adj.build((const lits::str *)ptrs.data(), cnt);
+        std::vector<int> lcps(adj.lcp);
+        for (int l : lcps)
+            lcp_avg += l;
+        lcp_avg /= lcps.size();
+
+        std::sort(lens.begin(), lens.end());
+        std::sort(lcps.begin(), lcps.end());
+        len_min = lens.front();
+        len_p50 = lens[lens.size() / 2];
+        len_p99 = lens[lens.size() * 99 / 100];
+        len_max = lens.back();
+        lcp_p50 = lcps[lcps.size() / 2];
+        lcp_p99 = lcps[lcps.size() * 99 / 100];
+        lcp_max = lcps.back();
+
+        int lcpl = lits::ucpl((lits::str)ptrs.front(), (lits::str)ptrs.back());
+        gpkl = adj.getGPKL(0, cnt, lcpl);
+        root_type = lits::PMSS().decideSubType(cnt, gpkl);
+    }
+
+    void print(std::ostream &os = std::cout) const {
+        static const char *styp_names[] = {"Model", "HOT", "Cnode"};
+        os << "[Keys]: Count:\t" << cnt << ", alphabet " << alphabet
+           << std::endl;
+        os << "[Keys]: Length:\tavg " << len_avg << ", min " << len_min
+           << ", p50 " << len_p50 << ", p99 " << len_p99 << ", max "
+           << len_max << std::endl;
+        os << "[Keys]: Adjacent LCP:\tavg " << lcp_avg << ", p50 " << lcp_p50
+           << ", p99 " << lcp_p99 << ", max " << lcp_max << std::endl;
+        os << "[Keys]: GPKL:\t" << gpkl << ", root " << styp_names[root_type]
+           << std::endl;
+    }
+};
+
 const int IdGenerator::ProvinceCodes[IdGenerator::ProvinceCodeCnt] = {
     11, 12, 13, 14, 15, 21, 22, 23, 31, 32, 33, 34, 35, 36, 37, 41, 42,
     43, 44, 45, 46, 50, 51, 52, 53, 54, 61, 62, 63, 64, 65, 71, 81, 82};
+
+/**
+ * xorshift64* generator, one per thread.
+ */
+class Rand {
+  private:
+    uint64_t s;
+
+  public:
+    Rand(uint64_t seed) : s(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    inline uint64_t next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, 1)
+    inline double unit() { return (next() >> 11) * (1.0 / (1ULL << 53)); }
+};
+
+/**
+ * Zipfian generator over [0, n) (Gray et al., as used by YCSB). The zeta
+ * constant is computed once and can be shared by threads.
+ */
+class Zipfian {
+  private:
+    uint64_t n;
+    double theta, alpha, zetan, eta;
+
+  public:
+    Zipfian() = default;
+    Zipfian(uint64_t _n, double _theta) : n(_n), theta(_theta) {
+        double zeta2 = 1 + std::pow(0.5, theta);
+        zetan = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            zetan += 1 / std::pow((double)i, theta);
+        }
+        alpha = 1 / (1 - theta);
+        eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    inline uint64_t next(Rand &rnd) const {
+        double u = rnd.unit();
+        double uz = u * zetan;
+        if (uz < 1)
+            return 0;
+        if (uz < 1 + std::pow(0.5, theta))
+            return 1;
+        uint64_t v = n * std::pow(eta * u - eta + 1, alpha);
+        return v < n ? v : n - 1;
+    }
+};
+
+/**
+ * Scatter the popular items over the key space (YCSB's scrambled zipfian).
+ */
+inline uint64_t scramble(uint64_t v, uint64_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+        h = (h ^ (v & 0xff)) * 0x100000001b3ULL;
+        v >>= 8;
+    }
+    return h % n;
+}
@@ -70,6 +70,23 @@ template <typename ValueType> class HOTSingleThreadedIterator {
         mCurrentDepth = other.mCurrentDepth;
     }
 
+    // The stack must stay in this iterator's own buffer, so the implicit
+    // assignment (which copies mNodeStack) would leave it dangling
+    HOTSingleThreadedIterator&
+    operator=(HOTSingleThreadedIterator const& other) {
+        if (this == &other) {
+            return *this;
+        }
+        mNodeStack =
+            reinterpret_cast<HOTSingleThreadedIteratorStackEntry*>(
+                mRawNodeStack);
+        std::memcpy(this->mRawNodeStack, other.mRawNodeStack,
+                    sizeof(HOTSingleThreadedIteratorStackEntry) *
+                        (other.mCurrentDepth + 1));
+        mCurrentDepth = other.mCurrentDepth;
+        return *this;
+    }
+
     HOTSingleThreadedIterator()
         : mNodeStack(reinterpret_cast<HOTSingleThreadedIteratorStackEntry*>(
               mRawNodeStack)) {
@@ -16,7 +16,9 @@ constexpr uint32_t ALL_ENTRIES_USED = UINT32_MAX; //32 1 bits
 namespace hot { namespace singlethreaded {
 
 inline MemoryPool<uint64_t, MAXIMUM_NODE_SIZE_IN_LONGS>* HOTSingleThreadedNodeBase::getMemoryPool() {
-	static MemoryPool<uint64_t, MAXIMUM_NODE_SIZE_IN_LONGS> memoryPool {};
+	//one pool per thread: the free lists are unsynchronized, and writers of different LITS shards run concurrently.
+	//A node may be returned to the pool of another thread than the one it came from, as the blocks are plain posix_memalign memory.
+	static thread_local MemoryPool<uint64_t, MAXIMUM_NODE_SIZE_IN_LONGS> memoryPool {};
 	return &memoryPool;
 }
 
@@ -4,9 +4,18 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 
 namespace hot { namespace singlethreaded {
 
+/**
+ * Optional callback observing the bytes handed out by (positive) and returned to (negative) the memory pools.
+ */
+inline void (*&memoryPoolHook())(std::ptrdiff_t) {
+	static void (*hook)(std::ptrdiff_t) = nullptr;
+	return hook;
+}
+
 class FreeListEntry;
 
 class FreeListEntry {
@@ -74,10 +83,18 @@ public:
 			head = head->getNext();
 		}
 
+		if(memoryPoolHook() != nullptr) {
+			memoryPoolHook()(numberElements * ELEMENT_SIZE);
+		}
+
 		return rawMemory;
 	}
 
 	void returnToPool(size_t numberElements, void* rawMemory) {
+		if(memoryPoolHook() != nullptr) {
+			memoryPoolHook()(-static_cast<std::ptrdiff_t>(numberElements * ELEMENT_SIZE));
+		}
+
 		FreeListEntry* & head = getFreeListHead(numberElements);
 		if(head->getListSize() < SIZE_BEFORE_EVICTION_BEGIN_SIZE) {
 			head = new (rawMemory) FreeListEntry(head);
@@ -1,18 +1,63 @@
 #pragma once
 
+#include "lits_cache.hpp"
 #include "lits_cnode.hpp"
 #include "lits_hot.hpp"
 #include "lits_iter.hpp"
 #include "lits_kv.hpp"
 #include "lits_model.hpp"
 #include "lits_node.hpp"
+#include "lits_perf.hpp"
+#include "lits_policy.hpp"
+#include "lits_stats.hpp"
+#include "lits_trace.hpp"
 
 #include <cmath>
 #include <stack>
 
 namespace lits {
 
-class LITS {
+/**
+ * Wall time (seconds) spent in each phase of the last bulk load, and the
+ * sub-tries it built.
+ */
+class BulkloadPhases {
+  public:
+    double validate = 0;  // sortedness check (and the adjacent lcp table)
+    double train = 0;     // HPT::train
+    double pmss_init = 0; // new PMSS
+    double build = 0;     // recursive pmss_bulk
+    double gpkl = 0;      // getGPKL calls within pmss_bulk
+
+    // Sub-tries built by pmss_bulk, by type
+    uint64_t model_nodes = 0;
+    uint64_t hot_subtries = 0;
+    uint64_t cnodes = 0;
+
+    // Model-based node attempts which fell back to HOT
+    uint64_t model_fails = 0;
+
+    // Whether the root is a radix node
+    bool radix_root = false;
+
+    // The hardware counters of each phase, valid only if counters were set
+    PerfSample validate_pc, train_pc, build_pc;
+
+    double total() const { return validate + train + pmss_init + build; }
+};
+
+/**
+ * The value kept by a key in both indexes on LITS::merge.
+ */
+typedef enum {
+    MERGE_KeepOurs = 0, // the value in the index merged into
+    MERGE_TakeTheirs,   // the value in the index merged in
+} MergePolicy;
+
+/**
+ * The LITS index, with the structural parameters of Policy (a LitsPolicy).
+ */
+template <class Policy = DefaultPolicy> class BasicLITS {
   private:
     // For bulk load, the index needs at least 1000 strings to train the model
     static const int min_bulk_load_size = 1000;
@@ -21,36 +66,135 @@ class LITS {
     bool hasBeenBuild = false;
 
     // The Global String Model: Hash-enhanced Prefix Table
-    HPT *hpt;
+    HPT *hpt = NULL;
+
+    // Whether hpt is freed with the index (not if passed to bulkload)
+    bool ownsHpt = true;
 
     // The Structural Decision Tree
-    PMSS *pmss;
+    PMSS *pmss = NULL;
 
     // The root node of the index.
     Item root;
 
+    // Whether bulk load shares one adjacent lcp table across all phases
+    bool useAdjLCP = true;
+
+    // The most item array slots per key a model-based node may choose (none
+    // by default, every node gets the policy's scale factor)
+    double scaleBudget = 0;
+
+    // Whether bulk load may build a radix root
+    bool useRadixRoot = false;
+
+    // Whether an insert after the keys of the last one resumes its path
+    bool useAppendCursor = true;
+
+    // The phase breakdown of the last bulk load
+    BulkloadPhases phases;
+
+    // The incrementally maintained counters of this index
+    Counters counters;
+
+    // The listener of structural rebuilds, NULL if none
+    RebuildListener *listener = NULL;
+
+    // The hardware counters read around the bulk load phases, NULL if none
+    const PerfCounters *perf = NULL;
+
+    // The hot-key cache in front of the lookups, NULL if disabled
+    LookupCache *cache = NULL;
+
+    // The path of the last insert, resumed by the next one if it appends
+    AppendCursor cursor;
+
+    // An inner node whose number of keys a range or batch remove decreased
+    typedef struct {
+        Item *father;
+        int ccpl;
+        int depth;
+    } trimmed;
+
   public:
-    LITS() = default;
-    ~LITS() = default;
+    BasicLITS() = default;
+    ~BasicLITS() = default;
+
+    // The index owns its model, nodes and cache: it is moved, never copied
+    BasicLITS(const BasicLITS &) = delete;
+    BasicLITS &operator=(const BasicLITS &) = delete;
 
+    BasicLITS(BasicLITS &&other) { *this = std::move(other); }
+
+    /**
+     * Take over the index of other, which is left as a new index. This index
+     * must not hold one (destroy it first).
+     */
+    BasicLITS &operator=(BasicLITS &&other) {
+        if (&other == this)
+            return *this;
+        RT_ASSERT(hasBeenBuild == false);
+        hasBeenBuild = other.hasBeenBuild;
+        hpt = other.hpt;
+        ownsHpt = other.ownsHpt;
+        pmss = other.pmss;
+        root = other.root;
+        useAdjLCP = other.useAdjLCP;
+        scaleBudget = other.scaleBudget;
+        useRadixRoot = other.useRadixRoot;
+        useAppendCursor = other.useAppendCursor;
+        phases = other.phases;
+        counters = other.counters;
+        listener = other.listener;
+        perf = other.perf;
+        cache = other.cache;
+
+        // The kept path may start at the root item of other
+        cursor.invalidate();
+        other.cursor.invalidate();
+        other.hasBeenBuild = false;
+        other.hpt = NULL;
+        other.ownsHpt = true;
+        other.pmss = NULL;
+        other.root.set_null();
+        other.counters = Counters();
+        other.cache = NULL;
+        return *this;
+    }
+
+    /**
+     * Bulk load the sorted unique keys. The model is trained on them, unless
+     * _hpt is given: a model shared with other indexes, which is not owned
+     * and must outlive them. Indexes sharing the model merge by grafting
+     * their model-based nodes too (see merge).
+     */
     bool bulkload(const char **_keys, const uint64_t *_vals, const int _len,
                   HPT *_hpt = NULL) {
         RT_ASSERT(hasBeenBuild == false);
+        CountersScope scope(&counters);
         return _bulkload((const str *)_keys, _vals, _len, _hpt);
     }
 
     void destroy() {
         RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        set_lookup_cache(0);
+        cursor.invalidate();
         return _destroy();
     }
 
     kv *lookup(const char *_key) {
         RT_ASSERT(hasBeenBuild);
+        LITS_TRACE_SCOPE(TOP_Lookup);
+        if (cache)
+            return _cached_lookup((const str)_key);
         return _lookup((const str)_key);
     }
 
     bool insert(const char *_key, const uint64_t _val) {
         RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Insert);
         return _insert((const str)_key, (const val)_val);
     }
 
@@ -60,24 +204,322 @@ class LITS {
      */
     val upsert(const char *_key, const uint64_t _val) {
         RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Upsert);
+        cursor.invalidate();
         return _upsert((const str)_key, (const val)_val);
     }
 
+    /**
+     * Insert, resuming the descent from the path of hint, an iterator
+     * returned by find on a nearby key (and not advanced since). The
+     * positions the new key would take anyway are reused; it descends from
+     * the root if the hint is stale or shares no position with the key.
+     */
+    bool insert_hint(const litsIter &hint, const char *_key,
+                     const uint64_t _val) {
+        RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Insert);
+        int ccpl;
+        PathStack &stack = cursor.stack;
+        Item *item = _resume(hint, (const str)_key, ccpl, stack);
+        return _insert_from((const str)_key, (const val)_val, item, ccpl,
+                            stack);
+    }
+
+    /**
+     * Upsert as upsert, resuming from the path of hint as insert_hint.
+     */
+    val upsert_hint(const litsIter &hint, const char *_key,
+                    const uint64_t _val) {
+        RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Upsert);
+        cursor.invalidate();
+        int ccpl;
+        PathStack stack(hpt, pmss, listener);
+        Item *item = _resume(hint, (const str)_key, ccpl, stack);
+        return _upsert_from((const str)_key, (const val)_val, item, ccpl,
+                            stack);
+    }
+
     bool remove(const char *_key) {
         RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Remove);
+        cursor.invalidate();
         return _remove((const str)_key);
     }
 
-    litsIter find(const char *_key) const {
+    /**
+     * Remove every key in [lo, hi), and return the number of keys removed.
+     * The sub-tries entirely within the range are freed in one step, only
+     * the nodes on the paths of lo and hi are trimmed key by key, and every
+     * inner node has its number of keys (and a possible shrink) adjusted
+     * once.
+     */
+    uint64_t remove_range(const char *lo, const char *hi) {
+        RT_ASSERT(hasBeenBuild);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Remove);
+        cursor.invalidate();
+        if (ustrcmp((const str)lo, (const str)hi) >= 0)
+            return 0;
+        std::vector<trimmed> trim;
+        uint64_t removed =
+            _remove_range(root, (const str)lo, (const str)hi, 0, 0, trim);
+        _shrink_trimmed(trim);
+        return removed;
+    }
+
+    /**
+     * Remove the keys of the sorted array _keys, and return the number of
+     * keys removed. The keys falling into the same slot of an inner node
+     * share one descent, and every inner node has its number of keys (and a
+     * possible shrink) adjusted once.
+     */
+    uint64_t remove_sorted_batch(const char **_keys, const int _len) {
+        RT_ASSERT(hasBeenBuild);
+        for (int i = 1; i < _len; ++i) {
+            if (ustrcmp((const str)_keys[i], (const str)_keys[i - 1]) < 0) {
+                std::cerr << "[Remove Batch]: The input strings are not "
+                             "sorted!"
+                          << std::endl;
+                return 0;
+            }
+        }
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        LITS_TRACE_SCOPE(TOP_Remove);
+        cursor.invalidate();
+        if (_len <= 0)
+            return 0;
+        std::vector<trimmed> trim;
+        uint64_t removed =
+            _remove_batch(root, (const str *)_keys, 0, _len, 0, 0, trim);
+        _shrink_trimmed(trim);
+        return removed;
+    }
+
+    /**
+     * Merge other into this index, and return the number of keys added.
+     * other is left empty, and still has to be destroyed. A key in both
+     * keeps the kv entry of this index, with the value chosen by policy.
+     *
+     * other is walked in key order, sub-trie by sub-trie. A sub-trie whose
+     * keys all fall into an empty slot of this index is grafted as it is:
+     * leaves (single entries, Cnodes and HOT) always, model-based nodes if
+     * both indexes share the HPT. The other keys are merged into the
+     * sub-tries they overlap, which are rebuilt by pmss_bulk over the merged
+     * sorted entries when they receive many. No kv entry is copied.
+     */
+    uint64_t merge(BasicLITS &&other,
+                   const MergePolicy policy = MERGE_KeepOurs) {
+        RT_ASSERT(hasBeenBuild && other.hasBeenBuild && &other != this);
+        cursor.invalidate();
+        other.cursor.invalidate();
+        if (other.cache)
+            other.cache->clear();
+
+        // The structures of other move here, with their bytes
+        counters.take_bytes(other.counters);
+        CountersScope scope(&counters);
+        CacheScope cscope(cache);
+        Item src = other.root;
+        other.root.set_null();
+        return _graft(src, 0, other.hpt == hpt, policy);
+    }
+
+    /**
+     * Split the index at key: the keys not less than key are moved into the
+     * returned index, and this index keeps the others. The returned index
+     * has its own copy of the HPT and PMSS, and is destroyed on its own.
+     *
+     * Only the path of key is cut. Every inner node on it hands the slots
+     * after the one of key over to a copy of itself with the same model, and
+     * the leaf on it is rebuilt on both sides. The nodes left sparse on
+     * either path are then shrunk as after a range remove. The other
+     * sub-tries move as they are, and no kv entry is copied.
+     */
+    BasicLITS split(const char *key) {
+        RT_ASSERT(hasBeenBuild);
+        cursor.invalidate();
+        if (cache)
+            cache->clear();
+
+        BasicLITS right;
+        right.hpt = new HPT(*hpt);
+        right.pmss = new PMSS(*pmss);
+        right.useAdjLCP = useAdjLCP;
+        right.scaleBudget = scaleBudget;
+        right.useAppendCursor = useAppendCursor;
+        right.hasBeenBuild = true;
+
+        CountersScope scope(&counters);
+        std::vector<trimmed> left_trim, right_trim;
+        uint64_t total = count_keys(root);
+        uint64_t moved = _split(root, right.root, (str)key, 0, 0, right,
+                                left_trim, right_trim);
+        _shrink_trimmed(left_trim);
+        right._shrink_trimmed(right_trim);
+
+        // Hand the bytes of the moved structures over, measured on the
+        // smaller side
+        Counters part;
+        if (2 * moved <= total) {
+            measure_bytes(right.root, part);
+            counters.move_bytes(right.counters, part);
+        } else {
+            measure_bytes(root, part);
+            right.counters.take_bytes(counters);
+            right.counters.move_bytes(counters, part);
+        }
+        return right;
+    }
+
+    /**
+     * Return an iterator at _key, invalid if _key is not in the index.
+     */
+    litsIter find(const char *_key) {
         RT_ASSERT(hasBeenBuild);
+        LITS_TRACE_SCOPE(TOP_Scan);
         return _find((const str)_key);
     }
 
-    litsIter begin() const {
+    litsIter begin() {
         RT_ASSERT(hasBeenBuild);
         return _begin();
     }
 
+    /**
+     * Enable or disable the shared adjacent lcp table in bulk load. When
+     * disabled, every recursion level rescans the keys to compute the GPKL.
+     */
+    void set_adj_lcp(bool enable) { useAdjLCP = enable; }
+
+    /**
+     * Set the most item array slots per key a model-based node may choose
+     * from a dry run of its keys (see PMSS::decideScaleFactor), for the nodes
+     * built from now on. Below 1, every node gets the policy's scale factor
+     * (the default); 2 * Policy::scale_factor lets the nodes choose 0.5x to
+     * 2x of it.
+     */
+    void set_scale_budget(const double budget) {
+        scaleBudget = budget;
+        if (hasBeenBuild)
+            pmss->scale_budget = budget;
+    }
+
+    /**
+     * Enable or disable the radix root in bulk load (disabled by default).
+     * When enabled, the root dispatches on the two bytes after the common
+     * prefix of the keys with a single load, instead of a model prediction,
+     * if that is estimated cheaper (see radix_node_pays).
+     */
+    void set_radix_root(bool enable) { useRadixRoot = enable; }
+
+    /**
+     * Enable or disable the append cursor (enabled by default). When
+     * disabled, every insert descends from the root, even one after the
+     * last inserted key.
+     */
+    void set_append_cursor(bool enable) {
+        useAppendCursor = enable;
+        cursor.invalidate();
+    }
+
+    const BulkloadPhases &bulkload_phases() const { return phases; }
+
+    /**
+     * Set the hardware counters to read around each bulk load phase, NULL to
+     * remove them. The counters are not owned by the index.
+     */
+    void set_perf_counters(const PerfCounters *_perf) { perf = _perf; }
+
+    /**
+     * Put a hot-key cache of (at most) budget bytes in front of the lookups,
+     * replacing the current one, or remove it with a budget of 0. It pays
+     * off on skewed lookups only, since every lookup hashes the key first.
+     */
+    void set_lookup_cache(const uint64_t budget) {
+        delete cache;
+        cache = budget ? new LookupCache(budget) : NULL;
+    }
+
+    /**
+     * Return the hit rate and the memory of the lookup cache, all 0 if none.
+     */
+    CacheStats cache_stats() const {
+        return cache ? cache->stats() : CacheStats();
+    }
+
+    /**
+     * Set the listener called on every path rebuild, Cnode promotion and
+     * Sing/Cnode conversion caused by the writes, NULL to remove it. The
+     * listener is not owned by the index.
+     */
+    void set_rebuild_listener(RebuildListener *_listener) {
+        listener = _listener;
+        cursor.invalidate();
+    }
+
+    /**
+     * Return the structural statistics of the index, computed by one
+     * traversal.
+     */
+    Stats stats() const {
+        RT_ASSERT(hasBeenBuild);
+        Stats s;
+        collect_stats(root, 0, s);
+        s.model_bytes = hpt->model_size();
+        s.path_rebuilds = counters.path_rebuilds;
+        s.cnode_rebulks = counters.cnode_rebulks;
+        s.appends = counters.appends;
+        s.hinted = counters.hinted;
+        s.model_fails[MFAIL_FlatCDF] = counters.fail_flat_cdf;
+        s.model_fails[MFAIL_Indiscernible] = counters.fail_indiscernible;
+        s.model_fails[MFAIL_Reversed] = counters.fail_reversed;
+        s.cache = cache_stats();
+        return s;
+    }
+
+    /**
+     * Return the model accuracy of every model-based inner node, and the
+     * model quality score. This is a diagnostic pass: it rebuilds the
+     * FAIL_TO_BULK fallbacks on the side to tell why the model fails.
+     */
+    ModelReport model_report() const {
+        RT_ASSERT(hasBeenBuild);
+        ModelReport rep;
+        rep.num_keys = collect_model_report(root, 0, 0, hpt, pmss, rep);
+        return rep;
+    }
+
+    /**
+     * Return the bytes used by the index, maintained incrementally.
+     */
+    uint64_t memory_usage() const {
+        RT_ASSERT(hasBeenBuild);
+        return counters.total_bytes() + hpt->model_size() +
+               cache_stats().bytes;
+    }
+
+    /**
+     * Return the bytes used by the index, split by what they store.
+     */
+    MemoryBreakdown memory_breakdown() const {
+        RT_ASSERT(hasBeenBuild);
+        return MemoryBreakdown(counters, hpt->model_size());
+    }
+
+    const Counters &get_counters() const { return counters; }
+
   private:
     bool _bulkload(const str *_keys, const uint64_t *_vals, const int _len,
                    HPT *_hpt = NULL) {
@@ -87,42 +529,112 @@ class LITS {
                       << min_bulk_load_size << " strings!" << std::endl;
             return false;
         }
+        if (_hpt && (_hpt->ps_len() != Policy::ps_hash_len ||
+                     _hpt->fc_len() != Policy::fc_hash_len)) {
+            std::cerr << "[Bulk Load]: The shared model has other hash "
+                         "lengths than the policy!"
+                      << std::endl;
+            return false;
+        }
 
-        for (int i = 1; i < _len; ++i) {
-            if (ustrcmp(_keys[i], _keys[i - 1]) < 0) {
-                std::cerr << "[Bulk Load]: The input strings are not sorted!"
-                          << std::endl;
+        double t0 = nowSec(), t1, t2, t3, t4;
+        PerfSample p0 = perf ? perf->read() : PerfSample(), p1, p2, p3;
+
+        AdjLCP adj;
+        if (useAdjLCP) {
+            if (!adj.build(_keys, _len)) {
+                int i = adj.violation + 1;
+                if (ustrcmp(_keys[i], _keys[i - 1]) < 0)
+                    std::cerr << "[Bulk Load]: The input strings are not "
+                                 "sorted!"
+                              << std::endl;
+                else
+                    std::cerr << "[Bulk Load]: The input strings are not "
+                                 "unique!"
+                              << std::endl;
                 return false;
             }
-            if (ustrcmp(_keys[i], _keys[i - 1]) == 0) {
-                std::cerr << "[Bulk Load]: The input strings are not unique!"
-                          << std::endl;
-                return false;
+        } else {
+            for (int i = 1; i < _len; ++i) {
+                if (ustrcmp(_keys[i], _keys[i - 1]) < 0) {
+                    std::cerr << "[Bulk Load]: The input strings are not "
+                                 "sorted!"
+                              << std::endl;
+                    return false;
+                }
+                if (ustrcmp(_keys[i], _keys[i - 1]) == 0) {
+                    std::cerr << "[Bulk Load]: The input strings are not "
+                                 "unique!"
+                              << std::endl;
+                    return false;
+                }
             }
         }
+        const AdjLCP *adj_ptr = useAdjLCP ? &adj : NULL;
+
+        t1 = nowSec();
+        if (perf)
+            p1 = perf->read();
 
         // Train the Hash-enhanced Prefix Table
+        ownsHpt = _hpt == NULL;
         if (_hpt) {
             hpt = _hpt;
         } else {
-            hpt = new HPT();
-            hpt->train(_keys, _len);
+            hpt = new HPT(Policy::ps_hash_len, Policy::fc_hash_len);
+            hpt->train(_keys, _len, adj_ptr);
         }
 
+        t2 = nowSec();
+        if (perf)
+            p2 = perf->read();
+
         // Init the Performance Model for Structure Selection
-        pmss = new PMSS();
+        pmss = new PMSS(1, 0, Policy::cnode_size, Policy::scale_factor);
+        pmss->scale_budget = scaleBudget;
+
+        t3 = nowSec();
 
         // Bulk load the root
-        KVS2 kvs = {(const str *)_keys, (const val *)_vals};
+        KVS2 kvs = {(const str *)_keys, (const val *)_vals, adj_ptr};
+        Counters before = counters;
+        counters.timing_phases = true;
+
+        phases.radix_root =
+            useRadixRoot && radix_node_pays(kvs, 0, _len, hpt, pmss);
+        if (phases.radix_root)
+            root.set_inner_node(bulk_radix_node(kvs, 0, _len, 0, hpt, pmss));
+        else
+            root = pmss_bulk(kvs, 0, _len, 0, hpt, pmss);
+
+        counters.timing_phases = false;
+        t4 = nowSec();
+        if (perf)
+            p3 = perf->read();
 
-        root = pmss_bulk(kvs, 0, _len, 0, hpt, pmss);
+        phases.validate = t1 - t0;
+        phases.train = t2 - t1;
+        phases.pmss_init = t3 - t2;
+        phases.build = t4 - t3;
+        phases.gpkl = (counters.gpkl_ns - before.gpkl_ns) / 1e9;
+        phases.model_nodes = counters.model_builds - before.model_builds;
+        phases.hot_subtries = counters.hot_builds - before.hot_builds;
+        phases.cnodes = counters.cnode_builds - before.cnode_builds;
+        phases.model_fails =
+            counters.fail_flat_cdf + counters.fail_indiscernible +
+            counters.fail_reversed - before.fail_flat_cdf -
+            before.fail_indiscernible - before.fail_reversed;
+        phases.validate_pc = p1 - p0;
+        phases.train_pc = p2 - p1;
+        phases.build_pc = p3 - p2;
 
         hasBeenBuild = true;
         return true;
     }
 
     void _destroy() {
-        delete hpt;
+        if (ownsHpt)
+            delete hpt;
         delete pmss;
 
         KVS1 kvs;
@@ -134,11 +646,23 @@ class LITS {
         kvs.self_delete();
     }
 
+    kv *_cached_lookup(const str _key) {
+        KeyMeta meta(_key);
+        kv *res = cache->find(_key, meta);
+        if (res == NULL) {
+            res = _lookup(_key);
+            if (res)
+                cache->admit(meta, res);
+        }
+        return res;
+    }
+
     kv *_lookup(const str _key) {
         int ccpl = 0;
         Item item = root;
 
         while (1) {
+            LITS_TRACE_VISIT(item.get_itype());
             switch (item.get_itype()) {
             case ITYP_Trie: {
                 return trie_search(item, _key);
@@ -156,18 +680,465 @@ class LITS {
 
             // Recursively locate the position
             item = *item.locate(_key, ccpl, hpt);
+            item.prefetch();
         }
 
         return NULL;
     }
 
+    // Remove the key from the leaf item (not an inner node)
+    bool _remove_leaf(Item &item, const str _key, const int ccpl,
+                      const int depth) {
+        RebuildWatch watch(listener, &item, depth);
+        switch (item.get_itype()) {
+        case ITYP_Trie:
+            return trie_remove(item, _key);
+        case ITYP_Sing:
+            return sing_remove(item, _key, ccpl);
+        case ITYP_CNod:
+            return cnod_remove(item, _key, hpt, pmss);
+        default:
+            return false;
+        }
+    }
+
+    // Free the whole sub-trie of item, and return its number of keys
+    uint64_t _detach(Item &item) {
+        KVS1 kvs;
+        item.recursive_extract(kvs);
+        kvs.self_delete();
+        item.set_null();
+        return kvs.getSize();
+    }
+
+    /**
+     * Remove the keys of [lo, hi) below item (a NULL bound is unbounded),
+     * recording the inner nodes trimmed in pre-order.
+     */
+    uint64_t _remove_range(Item &item, const str lo, const str hi,
+                           const int ccpl, const int depth,
+                           std::vector<trimmed> &trim) {
+        std::vector<std::string> keys;
+        switch (item.get_itype()) {
+        case ITYP_Null: {
+            return 0;
+        }
+        case ITYP_Sing: {
+            kv *entry = item.get_entry();
+            if ((lo && ustrcmp((str)entry->k, lo) < 0) ||
+                (hi && ustrcmp((str)entry->k, hi) >= 0))
+                return 0;
+            free_kv(entry);
+            item.set_null();
+            return 1;
+        }
+        case ITYP_CNod: {
+            Cnode *cnode = item.get_cnode();
+            for (int i = 0; i < cnode->h.key_cnt; ++i) {
+                kv *entry = RAW_KV(cnode->data[i]);
+                if ((lo && ustrcmp((str)entry->k, lo) < 0) ||
+                    (hi && ustrcmp((str)entry->k, hi) >= 0))
+                    continue;
+                keys.emplace_back(entry->k, entry->len);
+            }
+            break;
+        }
+        case ITYP_Trie: {
+            uint64_t coded_subtrie = item.get_coded_index();
+            HOTIndex &hot = (HOTIndex &)coded_subtrie;
+            for (auto it = lo ? HOTLowerBound(hot, lo) : HOTBegin(hot);
+                 it != HOTIndex::END_ITERATOR; ++it) {
+                kv *entry = (*it).getKV();
+                if (hi && ustrcmp((str)entry->k, hi) >= 0)
+                    break;
+                keys.emplace_back(entry->k, entry->len);
+            }
+            break;
+        }
+        case ITYP_Mult: {
+            InnerNode *node = item.get_inner_node();
+            Item *items = node->get_items();
+            int lo_ccpl = ccpl, hi_ccpl = ccpl;
+            int l = lo ? predictPos(node, lo, lo_ccpl, hpt) : 0;
+            int r = hi ? predictPos(node, hi, hi_ccpl, hpt)
+                       : node->get_item_array_len() - 1;
+            uint64_t removed = 0;
+
+            // predictPos is monotone in the key: the slots strictly between
+            // those of lo and hi hold keys of the range only
+            trim.push_back({&item, ccpl, depth});
+            for (int j = l; j <= r; ++j) {
+                if (items[j].is_empty())
+                    continue;
+                if (j > l && j < r)
+                    removed += _detach(items[j]);
+                else
+                    removed += _remove_range(
+                        items[j], j == l ? lo : NULL, j == r ? hi : NULL,
+                        j == l ? lo_ccpl : hi_ccpl, depth + 1, trim);
+            }
+            node->num_keys() -= removed;
+            return removed;
+        }
+        }
+
+        // Trim the boundary leaf key by key
+        uint64_t removed = 0;
+        for (const std::string &k : keys)
+            removed += _remove_leaf(item, (const str)k.c_str(), ccpl, depth);
+        return removed;
+    }
+
+    /**
+     * Remove the sorted keys [l, r) below item, recording the inner nodes
+     * trimmed in pre-order.
+     */
+    uint64_t _remove_batch(Item &item, const str *_keys, const int l,
+                           const int r, const int ccpl, const int depth,
+                           std::vector<trimmed> &trim) {
+        uint64_t removed = 0;
+        if (item.get_itype() != ITYP_Mult) {
+            for (int i = l; i < r; ++i)
+                removed += _remove_leaf(item, _keys[i], ccpl, depth);
+            return removed;
+        }
+
+        InnerNode *node = item.get_inner_node();
+        Item *items = node->get_items();
+        trim.push_back({&item, ccpl, depth});
+
+        // The keys of a slot are consecutive, since predictPos is monotone
+        int i = l, c = ccpl;
+        int pos = predictPos(node, _keys[i], c, hpt);
+        while (i < r) {
+            int j = i + 1, next_c = ccpl, next = pos;
+            for (; j < r; ++j) {
+                next_c = ccpl;
+                next = predictPos(node, _keys[j], next_c, hpt);
+                if (next != pos)
+                    break;
+            }
+            removed +=
+                _remove_batch(items[pos], _keys, i, j, c, depth + 1, trim);
+            i = j;
+            pos = next;
+            c = next_c;
+        }
+        node->num_keys() -= removed;
+        return removed;
+    }
+
+    /**
+     * Rebuild the trimmed inner nodes left too sparse (free the empty ones),
+     * top-down, so that the nodes below a rebuilt one are not
+     * rebuilt first.
+     */
+    void _shrink_trimmed(const std::vector<trimmed> &trim) {
+        int rebuilt = INT_MAX;
+        for (const trimmed &t : trim) {
+            if (t.depth > rebuilt)
+                continue;
+            rebuilt = INT_MAX;
+            InnerNode *node = t.father->get_inner_node();
+            if (!node->too_sparse(node->num_keys()))
+                continue;
+            if (node->num_keys() == 0)
+                _detach(*t.father);
+            else
+                rebuild_inner_node(t.father, t.ccpl, t.depth, hpt, pmss,
+                                   listener);
+            rebuilt = t.depth;
+        }
+    }
+
+    /**
+     * Move the keys not less than key from the sub-trie of left, reached at
+     * depth with ccpl bytes confirmed, into right, the same slot of the index
+     * split off. The inner nodes on both paths are recorded top-down, to be
+     * shrunk. Return the number of keys moved.
+     */
+    uint64_t _split(Item &left, Item &right, const str key, const int ccpl,
+                    const int depth, const BasicLITS &other,
+                    std::vector<trimmed> &left_trim,
+                    std::vector<trimmed> &right_trim) {
+        if (left.get_itype() != ITYP_Mult) {
+            kv *first = edge_entry(left, false);
+            if (first == NULL)
+                return 0;
+            if (ustrcmp((str)first->k, key) >= 0) {
+                right = left;
+                left.set_null();
+                return count_keys(right);
+            }
+            if (ustrcmp((str)edge_entry(left, true)->k, key) < 0)
+                return 0;
+
+            // The leaf holds keys of both sides: rebuild each
+            KVS1 kvs;
+            left.recursive_extract(kvs);
+            int n = kvs.getSize(), cut = 1;
+            while (ustrcmp((str)kvs.ret_kv(cut)->k, key) < 0)
+                cut++;
+            left = pmss_bulk(kvs, 0, cut, ccpl, hpt, pmss);
+            right = pmss_bulk(kvs, cut, n, ccpl, other.hpt, other.pmss);
+            return n - cut;
+        }
+
+        // The slots after the one of key move to a copy of the node
+        InnerNode *node = left.get_inner_node();
+        Item *items = node->get_items();
+        int len = node->get_item_array_len();
+        int c = ccpl;
+        int pos = predictPos(node, key, c, hpt);
+        InnerNode *copy = copy_inner_node_shell(node);
+        Item *copy_items = copy->get_items();
+        right.set_inner_node(copy);
+        left_trim.push_back({&left, ccpl, depth});
+        right_trim.push_back({&right, ccpl, depth});
+
+        uint64_t moved = 0;
+        for (int i = pos + 1; i < len; ++i) {
+            if (items[i].is_empty())
+                continue;
+            moved += count_keys(items[i]);
+            copy_items[i] = items[i];
+            items[i].set_null();
+        }
+        moved += _split(items[pos], copy_items[pos], key, c, depth + 1, other,
+                        left_trim, right_trim);
+        node->num_keys() -= moved;
+        copy->num_keys() = moved;
+        return moved;
+    }
+
+    /**
+     * Move the sub-trie src of the merged index, whose keys share src_ccpl
+     * bytes, into this index, and return the number of keys added.
+     */
+    uint64_t _graft(Item src, const int src_ccpl, const bool same_model,
+                    const MergePolicy policy) {
+        kv *first = edge_entry(src, false);
+        if (first == NULL)
+            return 0;
+        kv *last = edge_entry(src, true);
+
+        // The deepest item of this index both ends of src fall into
+        int ccpl;
+        PathStack stack(hpt, pmss, listener);
+        Item *item = _common_slot((str)first->k, (str)last->k, ccpl, stack);
+
+        // A model-based node only fits where it was built; a Cnode records
+        // the ccpl of its slot
+        if (item->is_empty() && (src.get_itype() != ITYP_Mult ||
+                                 (same_model && src_ccpl == ccpl))) {
+            if (src.get_itype() == ITYP_CNod)
+                src.get_cnode()->h.ccpl = ccpl;
+            *item = src;
+            uint64_t n = count_keys(src);
+            stack.change_num(n);
+            return n;
+        }
+
+        // The children of src may fall into distinct slots
+        if (item->get_itype() == ITYP_Mult && src.get_itype() == ITYP_Mult) {
+            InnerNode *node = src.get_inner_node();
+            Item *items = node->get_items();
+            int len = node->get_item_array_len();
+            int icpl = node->get_prefix_length();
+            uint64_t added = 0;
+            for (int i = 0; i < len; ++i) {
+                int c = i == 0 || i == len - 1 ? src_ccpl : src_ccpl + icpl;
+                added += _graft(items[i], c, same_model, policy);
+            }
+            free_inner_node(node);
+            return added;
+        }
+
+        // Merge the keys of src into the sub-trie they overlap
+        KVS1 kvs;
+        src.recursive_extract(kvs);
+        uint64_t added =
+            _merge_batch(*item, kvs, 0, kvs.getSize(), ccpl, policy);
+        stack.change_num(added);
+        return added;
+    }
+
+    // Descend with lo and hi while they take the same slot, recording the
+    // path, and return the deepest item holding both
+    Item *_common_slot(const str lo, const str hi, int &ccpl,
+                       PathStack &stack) {
+        Item *item = &root;
+        ccpl = 0;
+        while (item->get_itype() == ITYP_Mult) {
+            InnerNode *node = item->get_inner_node();
+            int lo_ccpl = ccpl, hi_ccpl = ccpl;
+            int pos = predictPos(node, lo, lo_ccpl, hpt);
+            if (predictPos(node, hi, hi_ccpl, hpt) != pos)
+                break;
+            stack.record_path(item, ccpl);
+            item = &node->get_items()[pos];
+            ccpl = lo_ccpl;
+        }
+        return item;
+    }
+
+    /**
+     * Merge the sorted entries [l, r) of the merged index into the sub-trie
+     * of item, and return the number of keys added. A sub-trie receiving
+     * many keys (as many as it holds, or enough to reach its resize
+     * boundary) is rebuilt over the merged entries instead.
+     */
+    uint64_t _merge_batch(Item &item, const KVS1 &kvs, const int l,
+                          const int r, const int ccpl,
+                          const MergePolicy policy) {
+        switch (item.get_itype()) {
+        case ITYP_Null: {
+            item = pmss_bulk(kvs, l, r, ccpl, hpt, pmss);
+            return r - l;
+        }
+        case ITYP_Trie: {
+            // HOT takes the keys one by one, as on insert, unless it
+            // receives as many as it holds
+            uint64_t n = r - l;
+            if (n > pmss->cnode_size && count_keys(item, n + 1) <= n)
+                break;
+            uint64_t coded_subtrie = item.get_coded_index();
+            HOTIndex &hot = (HOTIndex &)coded_subtrie;
+            uint64_t added = 0;
+            for (int i = l; i < r; ++i) {
+                kv *theirs = kvs.ret_kv(i);
+                kv *ours = HOTLookup(hot, (str)theirs->k);
+                if (ours) {
+                    _resolve(ours, theirs, policy);
+                } else {
+                    HOTInsert(hot, theirs);
+                    added++;
+                }
+            }
+            item.set_coded_index(hot);
+            return added;
+        }
+        case ITYP_Mult: {
+            InnerNode *node = item.get_inner_node();
+            uint64_t n = r - l;
+            if (n >= node->num_keys() ||
+                node->too_full(node->num_keys() + n))
+                break;
+
+            // The entries of a slot are consecutive, as in _remove_batch
+            Item *items = node->get_items();
+            uint64_t added = 0;
+            int i = l, c = ccpl;
+            int pos = predictPos(node, (str)kvs.ret_kv(i)->k, c, hpt);
+            while (i < r) {
+                int j = i + 1, next_c = ccpl, next = pos;
+                for (; j < r; ++j) {
+                    next_c = ccpl;
+                    next = predictPos(node, (str)kvs.ret_kv(j)->k, next_c,
+                                      hpt);
+                    if (next != pos)
+                        break;
+                }
+                added += _merge_batch(items[pos], kvs, i, j, c, policy);
+                i = j;
+                pos = next;
+                c = next_c;
+            }
+            node->num_keys() += added;
+            return added;
+        }
+        default:
+            break;
+        }
+
+        // Rebuild the sub-trie over the merged sorted entries
+        KVS1 ours, merged;
+        item.recursive_extract(ours);
+        uint64_t added = _merge_sorted(ours, kvs, l, r, merged, policy);
+        item = pmss_bulk(merged, 0, merged.getSize(), ccpl, hpt, pmss);
+        return added;
+    }
+
+    // Merge our sorted entries with theirs [l, r) into merged, and return
+    // the number of theirs kept
+    uint64_t _merge_sorted(const KVS1 &ours, const KVS1 &theirs, const int l,
+                           const int r, KVS1 &merged,
+                           const MergePolicy policy) {
+        int i = 0, j = l, n = ours.getSize();
+        uint64_t added = 0;
+        while (i < n || j < r) {
+            int cmp = i == n   ? 1
+                      : j == r ? -1
+                               : ustrcmp((str)ours.ret_kv(i)->k,
+                                         (str)theirs.ret_kv(j)->k);
+            if (cmp < 0) {
+                merged.push(ours.ret_kv(i++));
+            } else if (cmp > 0) {
+                merged.push(theirs.ret_kv(j++));
+                added++;
+            } else {
+                _resolve(ours.ret_kv(i), theirs.ret_kv(j++), policy);
+                merged.push(ours.ret_kv(i++));
+            }
+        }
+        return added;
+    }
+
+    // Keep our entry of a key in both indexes, and free theirs
+    void _resolve(kv *ours, kv *theirs, const MergePolicy policy) {
+        if (policy == MERGE_TakeTheirs)
+            ours->update(theirs->read());
+        free_kv(theirs);
+    }
+
+    // Bumped by every model-based node built and kv entry freed
+    uint64_t epoch() const {
+        return counters.model_builds + counters.kv_frees;
+    }
+
+    /**
+     * Seed the stack with the path of the hint, and return the item to
+     * resume the descent at.
+     */
+    Item *_resume(const litsIter &hint, const str _key, int &ccpl,
+                  PathStack &stack) {
+        stack.reset(hpt, pmss, listener);
+        Item *item = hint.resume(&root, _key, epoch(), ccpl, stack);
+        if (item == NULL) {
+            stack.reset(hpt, pmss, listener);
+            ccpl = 0;
+            return &root;
+        }
+        if (item != &root)
+            count(&Counters::hinted);
+        return item;
+    }
+
     bool _insert(const str _key, const val _val) {
         int ccpl = 0;
         Item *item = &root;
-        PathStack stack(hpt, pmss);
+        PathStack &stack = cursor.stack;
+
+        // Resume an append from the leaf of the last insert
+        if (useAppendCursor && cursor.accepts(_key)) {
+            count(&Counters::appends);
+            item = cursor.leaf;
+            ccpl = cursor.ccpl;
+        } else {
+            stack.reset(hpt, pmss, listener);
+        }
+
+        return _insert_from(_key, _val, item, ccpl, stack);
+    }
+
+    // Insert, descending from item with the path above it in stack
+    bool _insert_from(const str _key, const val _val, Item *item, int ccpl,
+                      PathStack &stack) {
         bool result;
 
         while (1) {
+            LITS_TRACE_VISIT(item->get_itype());
+            RebuildWatch watch(listener, item, stack.depth());
             switch (item->get_itype()) {
             case ITYP_Trie: {
                 result = trie_insert(*item, _key, _val);
@@ -198,19 +1169,29 @@ class LITS {
     RET:
 
         if (result == true) {
-            stack.change_num(1);
+            // A rebuild replaces the path below the rebuilt node
+            int i = stack.change_num(1);
+            if (i >= 0) {
+                item = stack.father(i);
+                ccpl = stack.ccpl(i);
+                stack.truncate(i);
+            }
         }
 
+        if (useAppendCursor)
+            cursor.keep(item, ccpl, _key);
         return result;
     }
 
     bool _remove(const str _key) {
         int ccpl = 0;
         Item *item = &root;
-        PathStack stack(hpt, pmss);
+        PathStack stack(hpt, pmss, listener);
         bool result;
 
         while (1) {
+            LITS_TRACE_VISIT(item->get_itype());
+            RebuildWatch watch(listener, item, stack.depth());
             switch (item->get_itype()) {
             case ITYP_Trie: {
                 result = trie_remove(*item, _key);
@@ -247,12 +1228,18 @@ class LITS {
     }
 
     val _upsert(const str _key, const val _val) {
-        int ccpl = 0;
-        Item *item = &root;
-        PathStack stack(hpt, pmss);
+        PathStack stack(hpt, pmss, listener);
+        return _upsert_from(_key, _val, &root, 0, stack);
+    }
+
+    // Upsert, descending from item with the path above it in stack
+    val _upsert_from(const str _key, const val _val, Item *item, int ccpl,
+                     PathStack &stack) {
         val result;
 
         while (1) {
+            LITS_TRACE_VISIT(item->get_itype());
+            RebuildWatch watch(listener, item, stack.depth());
             switch (item->get_itype()) {
             case ITYP_Trie: {
                 result = trie_upsert(*item, _key, _val);
@@ -294,15 +1281,17 @@ class LITS {
         Item item = root;
 
         litsIter iter;
+        iter.set_epoch(epoch());
 
         while (1) {
+            LITS_TRACE_VISIT(item.get_itype());
             switch (item.get_itype()) {
             case ITYP_Trie: {
                 trie_find(item, _key, iter);
                 return iter;
             };
             case ITYP_Sing: {
-                sing_find(item, iter);
+                sing_find(item, _key, ccpl, iter);
                 return iter;
             };
             case ITYP_CNod: {
@@ -325,8 +1314,31 @@ class LITS {
 
     litsIter _begin() const {
         litsIter iter;
-        iter.FIRST(root);
+
+        // The root shrinks into a leaf once most keys are removed
+        switch (root.get_itype()) {
+        case ITYP_Null: {
+            iter.set_invalid();
+            break;
+        }
+        case ITYP_Sing: {
+            iter.set_data(root.get_entry());
+            break;
+        }
+        case ITYP_Trie: {
+            uint64_t coded_subtrie = root.get_coded_index();
+            iter.Init_subtrieIter(HOTBegin((HOTIndex &)coded_subtrie),
+                                  coded_subtrie);
+            break;
+        }
+        default: {
+            iter.FIRST(root);
+        }
+        }
         return iter;
     }
 };
+
+typedef BasicLITS<DefaultPolicy> LITS;
+
 }; // namespace lits
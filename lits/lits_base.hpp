@@ -17,6 +17,15 @@
 #define likely(x) __builtin_expect((x), 1)
 #define unlikely(x) __builtin_expect((x), 0)
 
+// Opt-in software prefetching on the lookup path: compile with
+// -DLITS_PREFETCH to load the item array lines, child nodes and kv entries of
+// a descent ahead of their use
+#ifdef LITS_PREFETCH
+#define LITS_PREFETCH_ADDR(addr) __builtin_prefetch((const void *)(addr))
+#else
+#define LITS_PREFETCH_ADDR(addr) ((void)0)
+#endif
+
 // Runtime Assertion and Static Assertion
 #define RT_ASSERT(expr) assert(expr)
 #define ST_ASSERT(expr) static_assert(expr)
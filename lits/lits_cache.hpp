@@ -0,0 +1,245 @@
+#pragma once
+
+#include "lits_base.hpp"
+#include "lits_kv.hpp"
+#include "lits_utils.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace lits {
+
+/**
+ * A small cache in front of the lookups, mapping the length and hash of a
+ * key to its kv entry, so that the hottest keys skip the descent.
+ *
+ * The table is 4-way set-associative with one 64-byte set per cache line.
+ * Admission is TinyLFU-like: a count-min sketch of 8-bit counters estimates
+ * how often each key missing the cache was looked up recently, and a key
+ * replaces the least frequent entry of its set only if it is more frequent.
+ * Cached entries count their own hits instead, and both are halved
+ * periodically. The ROWS counters of a key lie in one 64-byte block of the
+ * sketch, so that a miss touches one more cache line only.
+ * One-hit keys never enter, so a scan of cold keys does not flush the hot
+ * ones.
+ *
+ * kv entries never move once created (rebuilds relink the same entries), so
+ * an entry only goes stale when its kv is freed. free_kv drops it through
+ * the cache bound to the running thread (see CacheScope). The cache is not
+ * thread-safe.
+ */
+class LookupCache {
+  private:
+    static const int WAYS = 4;
+    static const int ROWS = 4;
+
+    typedef struct {
+        uint32_t hash; // the key hash
+        uint16_t len;  // the (low 16 bits of the) key length
+        uint16_t freq; // the estimated frequency
+        kv *entry;     // NULL if empty
+    } slot;
+
+    typedef struct alignas(64) {
+        slot s[WAYS];
+    } set;
+
+    set *sets;
+    uint64_t set_mask;
+
+    // The frequency sketch, in 64-byte blocks
+    uint8_t *sketch;
+    uint64_t block_mask;
+
+    // Sketch increments since the last halving, and the halving period
+    uint64_t increments = 0;
+    uint64_t period;
+
+    CacheStats st;
+
+    static inline uint64_t tagOf(const uint32_t len, const uint32_t hash) {
+        return (uint64_t)(uint16_t)len << 32 | hash;
+    }
+
+    static inline uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    inline set &setOf(const uint64_t tag) const {
+        return sets[mix(tag) & set_mask];
+    }
+
+    // The r-th counter of the key: a 16-byte row of its block each
+    inline uint8_t &counter(const int r, const uint64_t tag) const {
+        uint64_t h = mix(tag ^ 0x9E3779B97F4A7C15ULL);
+        uint8_t *block = sketch + ((h & block_mask) << 6);
+        return block[r * 16 + ((h >> (32 + 4 * r)) & 15)];
+    }
+
+    // Count the key, and return its new frequency
+    uint8_t increment(const uint64_t tag) {
+        uint8_t f = 255;
+        for (int r = 0; r < ROWS; ++r) {
+            uint8_t &c = counter(r, tag);
+            if (c < 255)
+                c++;
+            f = std::min(f, c);
+        }
+        if (++increments >= period) {
+            // Age the counters, so that keys which cooled down are replaced
+            for (uint64_t i = 0; i < ((block_mask + 1) << 6); ++i)
+                sketch[i] >>= 1;
+            for (uint64_t i = 0; i <= set_mask; ++i) {
+                for (int j = 0; j < WAYS; ++j)
+                    sets[i].s[j].freq >>= 1;
+            }
+            increments = 0;
+        }
+        return f;
+    }
+
+  public:
+    /**
+     * Create a cache using (at most) budget bytes, at least four sets.
+     */
+    LookupCache(const uint64_t budget) {
+        // Each set costs 64 bytes plus ROWS sketch counters per way, i.e. a
+        // sketch block per 4 sets
+        const uint64_t per_set = sizeof(set) + WAYS * ROWS;
+        uint64_t n = quick2(std::max<uint64_t>(budget / per_set, 4));
+        if (n * per_set > budget && n > 4)
+            n /= 2;
+        set_mask = n - 1;
+        block_mask = n / 4 - 1;
+        period = 10 * n * WAYS;
+
+        // new does not honor the alignment of set before C++17
+        sets = (set *)aligned_alloc(64, n * sizeof(set));
+        memset(sets, 0, n * sizeof(set));
+        sketch = new uint8_t[n * WAYS * ROWS];
+        memset(sketch, 0, n * WAYS * ROWS);
+        st.bytes = n * per_set;
+    }
+
+    ~LookupCache() {
+        free(sets);
+        delete[] sketch;
+    }
+
+    LookupCache(const LookupCache &) = delete;
+    LookupCache &operator=(const LookupCache &) = delete;
+
+    /**
+     * Return the kv entry of the key if cached, otherwise NULL.
+     */
+    inline kv *find(const str key, const KeyMeta &meta) {
+        set &s = setOf(tagOf(meta.len, meta.hash));
+        st.lookups++;
+        for (int i = 0; i < WAYS; ++i) {
+            slot &e = s.s[i];
+            if (e.hash == meta.hash && e.len == (uint16_t)meta.len &&
+                e.entry && e.entry->verify(key)) {
+                st.hits++;
+                if (e.freq < UINT16_MAX)
+                    e.freq++;
+                return e.entry;
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * Record a lookup missing the cache, whose kv entry is found in the
+     * index, and admit the entry if it is frequent enough.
+     */
+    void admit(const KeyMeta &meta, kv *entry) {
+        uint64_t tag = tagOf(meta.len, meta.hash);
+        uint8_t freq = increment(tag);
+        if (freq < 2) {
+            st.rejections++;
+            return;
+        }
+        set &s = setOf(tag);
+
+        // Replace an empty slot, or the least frequent one
+        int victim = 0;
+        for (int i = 0; i < WAYS; ++i) {
+            if (s.s[i].entry == NULL) {
+                victim = i;
+                break;
+            }
+            if (s.s[i].freq < s.s[victim].freq)
+                victim = i;
+        }
+
+        slot &e = s.s[victim];
+        if (e.entry && freq <= e.freq) {
+            st.rejections++;
+            return;
+        }
+        e = {meta.hash, (uint16_t)meta.len, freq, entry};
+        st.admissions++;
+    }
+
+    /**
+     * Drop the kv entry, which is about to be freed, if cached.
+     */
+    void invalidate(const kv *entry) {
+        set &s = setOf(tagOf(entry->len, entry->hash));
+        for (int i = 0; i < WAYS; ++i) {
+            if (s.s[i].entry == entry) {
+                s.s[i] = {0, 0, 0, NULL};
+                st.invalidations++;
+            }
+        }
+    }
+
+    /**
+     * Drop every entry.
+     */
+    void clear() { memset(sets, 0, (set_mask + 1) * sizeof(set)); }
+
+    const CacheStats &stats() const { return st; }
+};
+
+/**
+ * Return the cache bound to the running thread, NULL if none.
+ */
+inline LookupCache *&activeCache() {
+    static thread_local LookupCache *cache = NULL;
+    return cache;
+}
+
+/**
+ * Bind the cache to the running thread until the end of the scope, so that
+ * the kv entries freed meanwhile are dropped from it.
+ */
+class CacheScope {
+  private:
+    LookupCache *prev;
+
+  public:
+    CacheScope(LookupCache *c) : prev(activeCache()) { activeCache() = c; }
+    ~CacheScope() { activeCache() = prev; }
+};
+
+/**
+ * Drop the freed kv entry from the bound cache (if any).
+ */
+inline void invalidateCached(const kv *entry) {
+    LookupCache *c = activeCache();
+    if (c)
+        c->invalidate(entry);
+}
+
+static const bool kv_free_hook_installed =
+    (kvFreeHook() = invalidateCached, true);
+
+}; // namespace lits
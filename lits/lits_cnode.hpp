@@ -19,7 +19,9 @@ class Cnode {
     cheader h;
     kv *data[0];
 
-    inline bool has_room() const { return h.key_cnt < CNODE_SIZE; }
+    inline bool has_room(const int cnode_size) const {
+        return h.key_cnt < cnode_size;
+    }
     inline bool more_than_2() const { return h.key_cnt > 2; }
 
     /**
@@ -32,6 +34,18 @@ class Cnode {
     }
 };
 
+/**
+ * Free a Cnode allocated by new_cnode or new_empty_cnode. The kv entries
+ * it points to are not freed.
+ *
+ * @param cnode pointer to the Cnode to be freed
+ */
+inline void free_cnode(Cnode *cnode) {
+    charge(&Counters::cnode_bytes, -(int64_t)cnode->cnode_size());
+    charge(&Counters::cnode_header_bytes, -(int64_t)sizeof(Cnode::cheader));
+    delete[] reinterpret_cast<uint8_t *>(cnode);
+}
+
 /**
  * Extracts data from the given Cnode and adds it to the provided KVS1.
  *
@@ -46,7 +60,7 @@ inline void extract_cnode(Cnode *cnode, KVS1 &kvs) {
     for (int i = 0; i < cnode->h.key_cnt; ++i) {
         kvs.push((kv *)PTR_RAW(cnode->data[i]));
     }
-    delete[] reinterpret_cast<uint8_t *>(cnode);
+    free_cnode(cnode);
 }
 
 /**
@@ -60,13 +74,15 @@ inline void extract_cnode(Cnode *cnode, KVS1 &kvs) {
  * @param kvs reference to KVS1
  * @param k constant string
  * @param v value
+ * @param meta the length and hash of k
  *
  * @return true if the insertion is successful, false if the key already exists
  *
  * @throws None
  */
 inline bool try_extract_keys_if_valid_insert(Cnode *cnode, KVS1 &kvs,
-                                             const str k, const val v) {
+                                             const str k, const val v,
+                                             const KeyMeta &meta) {
     // Extract the common prefix length
     int ccpl = cnode->h.ccpl;
     // Find the position to insert the new key
@@ -88,12 +104,12 @@ inline bool try_extract_keys_if_valid_insert(Cnode *cnode, KVS1 &kvs,
         kvs.push((kv *)PTR_RAW(cnode->data[j]));
     }
     // Insert the new key-value pair
-    kvs.push(new_kv(k, v));
+    kvs.push(new_kv(k, v, meta));
     for (int j = cut_pos; j < cnode->h.key_cnt; ++j) {
         kvs.push((kv *)PTR_RAW(cnode->data[j]));
     }
     // Delete the original Cnode
-    delete[] reinterpret_cast<uint8_t *>(cnode);
+    free_cnode(cnode);
     return true;
 }
 
@@ -104,13 +120,15 @@ inline bool try_extract_keys_if_valid_insert(Cnode *cnode, KVS1 &kvs,
  * @param kvs reference to KVS1
  * @param k constant string
  * @param v value
+ * @param meta the length and hash of k
  *
  * @return value that was updated or 0 if no update occurred
  *
  * @throws None
  */
 inline val try_extract_keys_if_valid_upsert(Cnode *cnode, KVS1 &kvs,
-                                            const str k, const val v) {
+                                            const str k, const val v,
+                                            const KeyMeta &meta) {
     int ccpl = cnode->h.ccpl;       // Confirmed common prefix length
     int cut_pos = cnode->h.key_cnt; // Position to cut the Cnode
     for (int i = 0; i < cnode->h.key_cnt; ++i) {
@@ -130,11 +148,11 @@ inline val try_extract_keys_if_valid_upsert(Cnode *cnode, KVS1 &kvs,
     for (int j = 0; j < cut_pos; ++j) {
         kvs.push((kv *)PTR_RAW(cnode->data[j]));
     }
-    kvs.push(new_kv(k, v));
+    kvs.push(new_kv(k, v, meta));
     for (int j = cut_pos; j < cnode->h.key_cnt; ++j) {
         kvs.push((kv *)PTR_RAW(cnode->data[j]));
     }
-    delete[] reinterpret_cast<uint8_t *>(cnode);
+    free_cnode(cnode);
     return 0;
 }
 
@@ -170,6 +188,8 @@ Cnode *new_cnode(const records &kvs, const int l, const int r, const int ccpl) {
     // Malloc the node
     ret = (Cnode *)new uint8_t[node_size];
     memset(ret, 0, node_size);
+    charge(&Counters::cnode_bytes, node_size);
+    charge(&Counters::cnode_header_bytes, sizeof(Cnode::cheader));
 
     // Set the fields
     ret->h.ccpl = ccpl;
@@ -195,6 +215,8 @@ Cnode *new_empty_cnode(const int number_of_slots) {
     int node_size = number_of_slots * sizeof(kv *) + sizeof(Cnode::cheader);
     Cnode *ret = (Cnode *)new uint8_t[node_size];
     memset(ret, 0, node_size);
+    charge(&Counters::cnode_bytes, node_size);
+    charge(&Counters::cnode_header_bytes, sizeof(Cnode::cheader));
     return ret;
 }
 
@@ -208,12 +230,35 @@ Cnode *new_empty_cnode(const int number_of_slots) {
  *
  * @param cnode pointer to the Cnode structure
  * @param ckey constant reference to the input string to be searched
+ * @param meta the length and hash of ckey
  *
  * @return pointer to the corresponding kv-entry if found, otherwise NULL
  */
-kv *_cnode_search(const Cnode *cnode, const str ckey) {
+kv *_cnode_search(const Cnode *cnode, const str ckey, const KeyMeta &meta) {
     // The input string's hash value
-    uint16_t hv = hashStr(ckey);
+    uint16_t hv = meta.fp();
+
+#ifdef LITS_PREFETCH
+    // Load the kv entries of all the fingerprint hits before verifying the
+    // first one (a cnode holds at most 64 keys)
+    uint64_t hits = 0;
+    for (int i = 0; i < cnode->h.key_cnt; ++i) {
+        if (hv == getHashVal(cnode->data[i])) {
+            hits |= 1UL << i;
+            LITS_PREFETCH_ADDR(RAW_KV(cnode->data[i]));
+        }
+    }
+    while (hits) {
+        int i = __builtin_ctzll(hits);
+        hits &= hits - 1;
+        kv *raw_kv = RAW_KV(cnode->data[i]);
+        if (raw_kv->verify(ckey, meta, cnode->h.ccpl)) {
+            return raw_kv;
+        }
+    }
+    return NULL;
+#endif
+
     // Search one by one
     for (int i = 0; i < cnode->h.key_cnt; ++i) {
         if (hv != getHashVal(cnode->data[i])) {
@@ -222,7 +267,7 @@ kv *_cnode_search(const Cnode *cnode, const str ckey) {
         kv *raw_kv = RAW_KV(cnode->data[i]);
 
         // Verify the remain parts of the string
-        bool match = raw_kv->verify(ckey, cnode->h.ccpl);
+        bool match = raw_kv->verify(ckey, meta, cnode->h.ccpl);
         if (match) {
             return raw_kv;
         }
@@ -237,11 +282,13 @@ kv *_cnode_search(const Cnode *cnode, const str ckey) {
  * @param cnode The pointer to the Cnode.
  * @param ckey The key to be inserted.
  * @param cval The value corresponding to the key.
+ * @param meta The length and hash of the key.
  *
  * @return true if the insertion is successful, false if the key already
  * exists.
  */
-bool _cnode_withRoom_insert(Cnode *&cnode, const str ckey, const val cval) {
+bool _cnode_withRoom_insert(Cnode *&cnode, const str ckey, const val cval,
+                            const KeyMeta &meta) {
     // The current confirmed common prefix in this cnode
     int ccpl = cnode->h.ccpl, cut_pos = cnode->h.key_cnt;
 
@@ -271,14 +318,14 @@ bool _cnode_withRoom_insert(Cnode *&cnode, const str ckey, const val cval) {
     for (int j = 0; j < cut_pos; ++j) {
         new_node->data[j] = cnode->data[j];
     }
-    new_node->data[cut_pos] = new_hash_kv(ckey, cval);
+    new_node->data[cut_pos] = new_hash_kv(ckey, cval, meta);
     for (int j = cut_pos; j < cnode->h.key_cnt; ++j) {
         new_node->data[j + 1] = cnode->data[j];
     }
 
     old_node = cnode;
     cnode = new_node;
-    delete[] reinterpret_cast<uint8_t *>(old_node);
+    free_cnode(old_node);
 
     return true;
 }
@@ -290,13 +337,15 @@ bool _cnode_withRoom_insert(Cnode *&cnode, const str ckey, const val cval) {
  * @param cnode A reference to a pointer to the Cnode structure
  * @param ckey The key to be upserted
  * @param cval The value to be upserted
+ * @param meta The length and hash of the key
  *
  * @return The old value if the key already exists, otherwise 0
  *
  * @throws None
  */
 
-val _cnode_withRoom_upsert(Cnode *&cnode, const str ckey, const val cval) {
+val _cnode_withRoom_upsert(Cnode *&cnode, const str ckey, const val cval,
+                           const KeyMeta &meta) {
     // The current confirmed common prefix in this cnode
     int ccpl = cnode->h.ccpl, cut_pos = cnode->h.key_cnt;
 
@@ -304,7 +353,7 @@ val _cnode_withRoom_upsert(Cnode *&cnode, const str ckey, const val cval) {
     Cnode *old_node, *new_node;
 
     // The input string's hash value
-    uint16_t hv = hashStr(ckey);
+    uint16_t hv = meta.fp();
 
     // First try to find a repeat key
     for (int i = 0; i < cnode->h.key_cnt; ++i) {
@@ -314,7 +363,7 @@ val _cnode_withRoom_upsert(Cnode *&cnode, const str ckey, const val cval) {
         kv *raw_kv = RAW_KV(cnode->data[i]);
 
         // Verify the remain parts of the string
-        bool match = raw_kv->verify(ckey, cnode->h.ccpl);
+        bool match = raw_kv->verify(ckey, meta, cnode->h.ccpl);
         if (match) {
             val old_val = raw_kv->read();
             raw_kv->update(cval);
@@ -342,18 +391,19 @@ val _cnode_withRoom_upsert(Cnode *&cnode, const str ckey, const val cval) {
     for (int j = 0; j < cut_pos; ++j) {
         new_node->data[j] = cnode->data[j];
     }
-    new_node->data[cut_pos] = new_hash_kv(ckey, cval);
+    new_node->data[cut_pos] = new_hash_kv(ckey, cval, meta);
     for (int j = cut_pos; j < cnode->h.key_cnt; ++j) {
         new_node->data[j + 1] = cnode->data[j];
     }
 
     old_node = cnode;
     cnode = new_node;
-    delete[] reinterpret_cast<uint8_t *>(old_node);
+    free_cnode(old_node);
     return 0;
 }
 
-bool _cnode_withRoom_remove(Cnode *&cnode, const str ckey) {
+bool _cnode_withRoom_remove(Cnode *&cnode, const str ckey,
+                            const KeyMeta &meta) {
     // The current confirmed common prefix in this cnode
     int ccpl = cnode->h.ccpl, delete_i = -1;
 
@@ -361,7 +411,7 @@ bool _cnode_withRoom_remove(Cnode *&cnode, const str ckey) {
     Cnode *old_node, *new_node;
 
     // The input string's hash value
-    uint16_t hv = hashStr(ckey);
+    uint16_t hv = meta.fp();
 
     // Search one by one, util find a key which is larger than ckey
     for (int i = 0; i < cnode->h.key_cnt; ++i) {
@@ -371,7 +421,7 @@ bool _cnode_withRoom_remove(Cnode *&cnode, const str ckey) {
         kv *raw_kv = RAW_KV(cnode->data[i]);
 
         // Verify the remain parts of the string
-        bool match = raw_kv->verify(ckey, cnode->h.ccpl);
+        bool match = raw_kv->verify(ckey, meta, cnode->h.ccpl);
 
         // If match, remove the target kv-entry
         if (match) {
@@ -400,7 +450,7 @@ bool _cnode_withRoom_remove(Cnode *&cnode, const str ckey) {
 
     old_node = cnode;
     cnode = new_node;
-    delete[] reinterpret_cast<uint8_t *>(old_node);
+    free_cnode(old_node);
 
     return true;
 }
@@ -411,7 +461,7 @@ bool _cnode_withRoom_remove(Cnode *&cnode, const str ckey) {
  * return NULL means no matched entry
  * return valid pointer means found a valid entry
  */
-kv *_cnode_degrade(Cnode *cnode, const str ckey) {
+kv *_cnode_degrade(Cnode *cnode, const str ckey, const KeyMeta &meta) {
     // This function will only be called when key count is 2
     RT_ASSERT(cnode->h.key_cnt == 2);
 
@@ -419,7 +469,7 @@ kv *_cnode_degrade(Cnode *cnode, const str ckey) {
     int delete_i = -1;
 
     // The input string's hash value
-    uint16_t hv = hashStr(ckey);
+    uint16_t hv = meta.fp();
 
     // The return entry
     kv *ret_entry = NULL;
@@ -432,7 +482,7 @@ kv *_cnode_degrade(Cnode *cnode, const str ckey) {
         kv *raw_kv = RAW_KV(cnode->data[i]);
 
         // Verify the remain parts of the string
-        bool match = raw_kv->verify(ckey, cnode->h.ccpl);
+        bool match = raw_kv->verify(ckey, meta, cnode->h.ccpl);
 
         // If match, remove the target kv-entry
         if (match) {
@@ -448,7 +498,7 @@ kv *_cnode_degrade(Cnode *cnode, const str ckey) {
     }
 
     ret_entry = RAW_KV(cnode->data[1 - delete_i]);
-    delete[] reinterpret_cast<uint8_t *>(cnode);
+    free_cnode(cnode);
 
     return ret_entry;
 }
@@ -25,6 +25,7 @@ class KVS1 {
         }
     }
     int getSize() const { return d.size(); }
+    const AdjLCP *adj_lcp() const { return NULL; }
 
   private:
     std::vector<kv *> d;
@@ -32,13 +33,16 @@ class KVS1 {
 
 class KVS2 {
   public:
-    KVS2(const str *keys, const val *vals) : _keys(keys), _vals(vals) {}
+    KVS2(const str *keys, const val *vals, const AdjLCP *adj = NULL)
+        : _keys(keys), _vals(vals), _adj(adj) {}
     KV operator[](int index) const { return {_keys[index], _vals[index]}; }
     kv *ret_kv(int index) const { return new_kv(_keys[index], _vals[index]); }
+    const AdjLCP *adj_lcp() const { return _adj; }
 
   private:
     const str *_keys;
     const val *_vals;
+    const AdjLCP *_adj;
 };
 
 }; // namespace lits
\ No newline at end of file
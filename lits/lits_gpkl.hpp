@@ -1,6 +1,10 @@
 #pragma once
 
 #include "lits_base.hpp"
+#include "lits_str.hpp"
+
+#include <algorithm>
+#include <thread>
 
 namespace lits {
 
@@ -11,15 +15,7 @@ namespace lits {
  *
  * @return the length of the string, excluding the terminating null character
  */
-inline int ustrlen(const str s) {
-    /* Iterate over the string until we reach the null character,
-       and return the number of characters we encountered. */
-    int i = 0;
-    for (; s[i]; ++i) {
-        // do nothing, just iterate
-    }
-    return i;
-}
+inline int ustrlen(const str s) { return str_len(s); }
 
 /**
  * Return the common prefix length of two strings.
@@ -32,14 +28,7 @@ inline int ustrlen(const str s) {
  *
  * @return the length of the common prefix of s1 and s2
  */
-inline int ucpl(const str s1, const str s2) {
-    int i = 0;
-    /* Find the first character that differs between s1 and s2, or the
-       null character if the strings are identical up to that point. */
-    for (; s1[i] && s2[i] && s1[i] == s2[i]; ++i)
-        ; /* do nothing, just iterate */
-    return i;
-}
+inline int ucpl(const str s1, const str s2) { return str_cpl(s1, s2); }
 
 /**
  * Return the common prefix length of two std::strings.
@@ -190,10 +179,120 @@ inline double lpkl(const std::vector<std::string> &keys) {
     return avg_dkl - lcpl;          // Local Partial Key Length
 }
 
+/**
+ * Adjacent LCP table of a sorted key array.
+ *
+ * lcp[i] is the common prefix length of keys[i] and keys[i + 1]. The
+ * distinguishing prefix length of keys[i] is max(lcp[i - 1], lcp[i]) + 1, so
+ * the GPKL of any range [l, r) can be derived from a prefix sum over those
+ * maxima in O(1), instead of rescanning the bytes of every adjacent pair at
+ * every level of the recursive bulk load.
+ *
+ * The table is built once, in parallel, and the same pass validates that the
+ * keys are sorted and unique.
+ */
+class AdjLCP {
+  public:
+    // Tables smaller than this are built by a single thread
+    static const int min_parallel_size = 1 << 16;
+
+    // lcp[i] = ucpl(keys[i], keys[i + 1]), i in [0, len - 1)
+    std::vector<int> lcp;
+
+    // psum[i] = sum of max(lcp[j - 1], lcp[j]) for j in [0, i)
+    std::vector<uint64_t> psum;
+
+    // The first i such that keys[i] >= keys[i + 1], -1 if sorted and unique
+    int violation = -1;
+
+    /**
+     * Build the table.
+     *
+     * @param keys The input keys.
+     * @param len The input data size, at least 2.
+     * @param threads The number of threads, 0 for hardware concurrency.
+     *
+     * @return true if the keys are sorted and unique, false otherwise.
+     */
+    bool build(const str *keys, const int len, int threads = 0) {
+        lcp.assign(len - 1, 0);
+        psum.assign(len + 1, 0);
+        violation = -1;
+
+        if (threads <= 0)
+            threads = std::max<int>(1, std::thread::hardware_concurrency());
+        if (len < min_parallel_size)
+            threads = 1;
+
+        // Compute the lcp array and the first violation of each chunk
+        std::vector<int> first_bad(threads, -1);
+        auto work = [&](int t) {
+            int lo = (int64_t)(len - 1) * t / threads;
+            int hi = (int64_t)(len - 1) * (t + 1) / threads;
+            for (int i = lo; i < hi; ++i) {
+                int c = ucpl(keys[i], keys[i + 1]);
+                lcp[i] = c;
+                if (unlikely(str_order(keys[i][c], keys[i + 1][c]) >= 0 &&
+                             first_bad[t] < 0)) {
+                    first_bad[t] = i;
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; ++t) {
+            pool.emplace_back(work, t);
+        }
+        work(0);
+        for (auto &th : pool) {
+            th.join();
+        }
+        for (int t = 0; t < threads && violation < 0; ++t) {
+            violation = first_bad[t];
+        }
+
+        // Prefix sum of the distinguishing lcp
+        for (int i = 0; i < len; ++i) {
+            psum[i + 1] = psum[i] + dlcp(i);
+        }
+
+        return violation < 0;
+    }
+
+    /**
+     * Return the distinguishing lcp of the i-th key in the whole array, i.e.
+     * the larger lcp with its two neighbours.
+     */
+    inline int dlcp(const int i) const {
+        int n = lcp.size();
+        int left = i > 0 ? lcp[i - 1] : 0;
+        int right = i < n ? lcp[i] : 0;
+        return std::max<int>(left, right);
+    }
+
+    /**
+     * Return the GPKL of keys in [l, r), same as the scanning version.
+     */
+    inline double getGPKL(const int l, const int r, const int lcpl) const {
+        const int len = r - l;
+        // The boundary keys only see one neighbour inside the range
+        uint64_t dkl_sum = lcp[l] + lcp[r - 2];
+        if (len > 2)
+            dkl_sum += psum[r - 1] - psum[l + 1];
+        double avg_dkl = (double)(dkl_sum + len) / len;
+        return avg_dkl - lcpl;
+    }
+};
+
 template <class records>
 double getGPKL(const records &kvs, const int l, const int r) {
     const int len = r - l;                      // Length of the group
     double lcpl = ucpl(kvs[l].k, kvs[r - 1].k); // Local Common Prefix Length
+
+    // Reuse the adjacent lcp table computed during bulk load
+    if (kvs.adj_lcp()) {
+        return kvs.adj_lcp()->getGPKL(l, r, lcpl);
+    }
+
     double dkl_sum = 0; // Sum of the Distinguishing Prefix Lengths
 
     // Calculate the average length of the distinguishing prefixes between each
@@ -225,23 +324,7 @@ double getGPKL(const records &kvs, const int l, const int r) {
  *
  * @return 1 if s1 > s2, -1 if s1 < s2, 0 if s1 == s2
  */
-inline int ustrcmp(const str s1, const str s2) {
-    /* Iterate over both strings until we reach a character that differs
-     * between the two strings, or until we reach the null character in both
-     * strings. */
-    int i = 0;
-    for (; s1[i] && s2[i] && s1[i] == s2[i]; ++i)
-        ;
-
-    /* If the characters at the current position in both strings are equal,
-     * then the strings are equal. */
-    if (s1[i] == s2[i])
-        return 0; // s1 == s2
-
-    /* Otherwise, return the ordering of the characters at the current position
-     * in both strings. */
-    return s1[i] > s2[i] ? 1 : -1;
-}
+inline int ustrcmp(const str s1, const str s2) { return str_cmp(s1, s2); }
 
 /**
  * Compare the given number of characters of two null-terminated strings and
@@ -254,16 +337,7 @@ inline int ustrcmp(const str s1, const str s2) {
  * @return 1 if s1 > s2, -1 if s1 < s2, 0 if s1 == s2
  */
 inline int ustrcmp(const str s1, const str s2, const int len) {
-    /* Iterate over the given number of characters of both strings and compare
-     * each character. If we encounter a character that differs between the two
-     * strings, return the ordering of those characters. If all characters are
-     * equal, then the strings are equal. */
-    for (int i = 0; i < len; ++i) {
-        if (s1[i] != s2[i]) {
-            return s1[i] > s2[i] ? 1 : -1;
-        }
-    }
-    return 0; // s1 == s2
+    return str_ncmp(s1, s2, len);
 }
 
 }; // namespace lits
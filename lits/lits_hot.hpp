@@ -40,6 +40,18 @@ inline auto HOTFind(const HOTIndex &index, const str k) -> HOTIter {
     return index.find(k);
 }
 
+/**
+ * @brief Find the first key not less than a key in the HOTIndex.
+ *
+ * @param index The HOTIndex object to be searched.
+ * @param k The key to be compared with.
+ *
+ * @return An iterator to the first key not less than k, or index.end().
+ */
+inline auto HOTLowerBound(const HOTIndex &index, const str k) -> HOTIter {
+    return index.lower_bound(k);
+}
+
 /**
  * @brief Returns an iterator to the first element of the HOTIndex.
  *
@@ -63,8 +75,14 @@ inline auto HOTBegin(const HOTIndex &index) -> HOTIter {
  * exists.
  */
 inline bool HOTInsert(HOTIndex &index, const str k, const uint64_t v) {
-    // Try to insert the key-value pair into the HOTIndex.
-    return index.insert(ST_kv(k, v));
+    // Try to insert the key-value pair into the HOTIndex, and free the new
+    // kv entry if the key exists.
+    ST_kv entry(k, v);
+    if (!index.insert(entry)) {
+        free_kv(entry.getKV());
+        return false;
+    }
+    return true;
 }
 
 /**
@@ -101,21 +119,41 @@ inline kv *HOTLookup(HOTIndex &index, const str k) {
 /**
  * @brief Insert or update a key-value pair in the HOTIndex.
  *
+ * An existing kv entry is updated in place, so that no entry is replaced.
+ *
  * @param index The HOTIndex object to be inserted or updated.
  * @param k The key to be inserted or updated.
  * @param v The value to be inserted or updated.
  *
- * @return A pointer to the inserted or updated key-value pair, or NULL if
- * insertion fails due to key already existing.
+ * @return The old value if the key exists, otherwise 0.
  */
-inline kv *HOTUpsert(HOTIndex &index, const str k, const uint64_t v) {
-    auto res = index.upsert(ST_kv(k, v));
-    /// Return the inserted or updated key-value pair if successful,
-    /// otherwise return NULL.
-    return res.mIsValid ? res.mValue.getKV() : NULL;
+inline uint64_t HOTUpsert(HOTIndex &index, const str k, const uint64_t v) {
+    kv *old = HOTLookup(index, k);
+    if (old) {
+        uint64_t old_val = old->read();
+        old->update(v);
+        return old_val;
+    }
+    index.insert(ST_kv(k, v));
+    return 0;
 }
 
-inline bool HOTRemove(HOTIndex &index, const str k) { return index.remove(k); }
+/**
+ * @brief Remove a key from the HOTIndex, and free its kv entry.
+ *
+ * @param index The HOTIndex object to be removed from.
+ * @param k The key to be removed.
+ *
+ * @return true if the key was found and removed.
+ */
+inline bool HOTRemove(HOTIndex &index, const str k) {
+    kv *old = HOTLookup(index, k);
+    if (old == NULL)
+        return false;
+    index.remove(k);
+    free_kv(old);
+    return true;
+}
 
 /**
  * @brief Bulkload a range of key-value pairs into the HOTIndex.
@@ -134,9 +172,10 @@ inline bool HOTRemove(HOTIndex &index, const str k) { return index.remove(k); }
 template <class record>
 inline void HOTBulkload(HOTIndex &index, const record &kvs, const int l,
                         const int r) {
-    // Insert the key-value pairs into the HOTIndex in bulk.
+    // Insert the key-value pairs into the HOTIndex in bulk. Records holding
+    // kv entries already (KVS1) hand them over instead of copying.
     for (int i = l; i < r; ++i) {
-        index.insert(ST_kv(kvs[i].k, kvs[i].v));
+        index.insert(ST_kv(kvs.ret_kv(i)));
     }
 }
 
@@ -3,6 +3,8 @@
 #include "lits_hot.hpp"
 #include "lits_node.hpp"
 
+#include <climits>
+
 namespace lits {
 class litsIter {
     typedef struct {
@@ -10,7 +12,8 @@ class litsIter {
         kv **kv_array;
         int array_len;
         int array_idx;
-
+        InnerNode *node; // The inner node, NULL in a Cnode
+        int plen;        // The key prefix length deciding array_idx, if known
     } info;
 
   private:
@@ -23,6 +26,8 @@ class litsIter {
     int depth;              // Current depth
     kv *data;               // Key-value pair
     info path[MAX_STACK];   // Recorded path
+    uint64_t epoch;         // The model-based nodes built before the find,
+                            // UINT64_MAX if not found or advanced since
 
   public:
     /**
@@ -49,6 +54,8 @@ class litsIter {
         data = NULL;
         // Recorded path
         memset(path, 0, sizeof(info) * MAX_STACK);
+        // No find
+        epoch = UINT64_MAX;
     }
 
     /**
@@ -125,11 +132,13 @@ class litsIter {
      * @param inode The InnerNode that the iterator is pointing to
      * @param _len The length of the item array of the InnerNode
      * @param _idx The index of the item in the item array of the InnerNode
+     * @param _plen The length of the key prefix which decided _idx
      */
-    inline void InnerNode_recordPath(InnerNode *inode, int _len, int _idx) {
+    inline void InnerNode_recordPath(InnerNode *inode, int _len, int _idx,
+                                     int _plen = INT_MAX) {
         RT_ASSERT(depth < MAX_STACK - 1);
         depth++;
-        path[depth] = {inode->get_items(), NULL, _len, _idx};
+        path[depth] = {inode->get_items(), NULL, _len, _idx, inode, _plen};
     }
 
     /**
@@ -150,7 +159,7 @@ class litsIter {
         RT_ASSERT(depth < MAX_STACK - 1);
         in_cnode = true;
         depth++;
-        path[depth] = {NULL, cnode->data, _len, _idx};
+        path[depth] = {NULL, cnode->data, _len, _idx, NULL, INT_MAX};
         data = RAW_KV(cnode->data[_idx]);
     }
 
@@ -182,6 +191,48 @@ class litsIter {
      */
     inline void set_data(kv *_data) { data = _data; } /* set_data */
 
+    inline void set_epoch(const uint64_t _epoch) { epoch = _epoch; }
+
+    /**
+     * Seed the stack with the inner nodes of the recorded path which the key
+     * passes through too, and return the item to resume the descent at.
+     *
+     * A recorded position is reused if the key shares with the found key the
+     * prefix which decided it. The path must still hang
+     * under root, and no model-based node may have been built since the find
+     * (cur_epoch differs otherwise), so that a freed node reused at the same
+     * address is not mistaken for the recorded one.
+     *
+     * @return the item to resume at, root if no recorded position is reused,
+     *         NULL if the path is stale (the stack must be reset then)
+     */
+    Item *resume(Item *root, const str key, const uint64_t cur_epoch,
+                 int &ccpl, PathStack &stack) const {
+        ccpl = 0;
+        if (!is_valid || is_end || epoch != cur_epoch)
+            return root;
+
+        int cpl = ucpl(key, getKV()->k);
+        Item *father = root;
+        for (int d = 0; d <= depth; ++d) {
+            const info &l = path[d];
+            if (l.node == NULL || cpl < l.plen)
+                break;
+            if (father->get_itype() != ITYP_Mult ||
+                father->get_inner_node() != l.node ||
+                l.node->get_item_array_len() != l.array_len)
+                return NULL;
+
+            stack.record_path(father, ccpl);
+
+            // The boundary slots are only reached on a prefix mismatch
+            if (l.array_idx != 0 && l.array_idx != l.array_len - 1)
+                ccpl += l.node->get_prefix_length();
+            father = &l.item_array[l.array_idx];
+        }
+        return father;
+    }
+
     /**
      * Incline the iterator.
      *
@@ -189,6 +240,9 @@ class litsIter {
      * such key-value pair, the iterator is set to be invalid.
      */
     void next() {
+        // The recorded path no longer leads to the found key
+        epoch = UINT64_MAX;
+
         // There are two cases for current iterator's status:
         // 1. the current iter is in a sub tree;
         // 2. the current iter is in LIT;
@@ -246,7 +300,8 @@ class litsIter {
             in_cnode = true;
             Cnode *cnode = father.get_cnode();
             RT_ASSERT(depth < MAX_STACK - 1);
-            path[++depth] = {NULL, cnode->data, (int)(cnode->h.key_cnt), 0};
+            path[++depth] = {NULL, cnode->data, (int)(cnode->h.key_cnt), 0,
+                             NULL, INT_MAX};
             data = RAW_KV(cnode->data[0]);
             return;
         }
@@ -276,7 +331,8 @@ class litsIter {
              * Record the information in the path.
              */
             RT_ASSERT(depth < MAX_STACK - 1);
-            path[++depth] = {item_array, NULL, item_array_len, i};
+            path[++depth] = {item_array, NULL, item_array_len, i, inode,
+                             INT_MAX};
 
             /*
              * Fill the data accordingly.
@@ -400,8 +456,9 @@ class litsIter {
 inline Item *recordPath_find(const Item &father, const str key, int &ccpl,
                              const HPT *hpt, litsIter &iter) {
     InnerNode *node = father.get_inner_node();
-    int pos = predictPos(node, key, ccpl, hpt);
-    iter.InnerNode_recordPath(node, node->h.item_array_length, pos);
+    int plen;
+    int pos = predictPos(node, key, ccpl, hpt, plen);
+    iter.InnerNode_recordPath(node, node->h.item_array_length, pos, plen);
     return &(node->get_items()[pos]);
 }
 
@@ -439,14 +496,23 @@ inline void trie_find(Item &item, const str _key, litsIter &iter) {
  * Find the single item in the iterator.
  *
  * This function finds the single item in the iterator, which must be a leaf
- * node. The item is set as the data pointer of the iterator.
+ * node. The item is set as the data pointer of the iterator if it holds the
+ * key. Otherwise, the iterator is set to invalid, as in a Cnode or a HOT.
  *
  * @param item The item to be searched
+ * @param _key The key to be searched for
+ * @param ccpl The common prefix length confirmed on the path
  * @param iter The iterator used to record the path of the search
  */
-inline void sing_find(Item &item, litsIter &iter) {
+inline void sing_find(Item &item, const str _key, const int ccpl,
+                      litsIter &iter) {
+    kv *entry = item.get_entry();
+    if (!entry->verify(_key, ccpl)) {
+        iter.set_invalid();
+        return;
+    }
     // Set the data pointer of the iterator to the found item
-    iter.set_data(item.get_entry());
+    iter.set_data(entry);
 }
 
 /**
@@ -469,8 +535,9 @@ inline void cnod_find(Item &item, const str _key, litsIter &iter) {
     // The query cnode
     Cnode *cnode = item.get_cnode();
 
-    // The input string's hash value
-    uint16_t hv = hashStr(_key);
+    // The input string's length and hash value
+    KeyMeta meta(_key);
+    uint16_t hv = meta.fp();
 
     // Search one by one
     for (int i = 0; i < cnode->h.key_cnt; ++i) {
@@ -480,7 +547,7 @@ inline void cnod_find(Item &item, const str _key, litsIter &iter) {
         kv *raw_kv = RAW_KV(cnode->data[i]);
 
         // Verify the remain parts of the string
-        bool match = raw_kv->verify(_key, cnode->h.ccpl);
+        bool match = raw_kv->verify(_key, meta, cnode->h.ccpl);
         if (match) {
             // Record the path of the search
             iter.CNode_recordPath(cnode, cnode->h.key_cnt, i);
@@ -3,6 +3,7 @@
 #include <cstring>
 
 #include "lits_base.hpp"
+#include "lits_stats.hpp"
 #include "lits_utils.hpp"
 
 #define RAW_KV(x) ((kv *)PTR_RAW(x))
@@ -11,20 +12,26 @@ namespace lits {
 
 class kv {
   public:
-    uint64_t v; // The value
-    char k[];   // The key
+    uint64_t v;    // The value
+    uint32_t len;  // The key length, excluding the null terminator
+    uint32_t hash; // The key hash, so rebuilds never rehash
+    char k[];      // The key
 
     /**
      * Set the key and value of the kv_load.
      *
      * @param key The key to be set
      * @param val The value to be set
+     * @param meta The length and hash of the key
      */
-    void set(const str key, const uint64_t val) {
+    void set(const str key, const uint64_t val, const KeyMeta &meta) {
         // Copy the key to the memory of the kv_load
-        memcpy(this->k, key, ustrlen(key) + 1);
+        memcpy(this->k, key, meta.len + 1);
         // Set the value of the kv_load
         this->v = val;
+        // Set the length and hash of the key
+        this->len = meta.len;
+        this->hash = meta.hash;
     }
 
     /**
@@ -51,6 +58,21 @@ class kv {
         return ustrcmp(key + ofs, (char *)(this->k + ofs)) == 0;
     }
 
+    /**
+     * Verify the key whose length and hash are known. Keys of a different
+     * length are rejected without touching the key bytes.
+     *
+     * @param key The key to be verified.
+     * @param meta The length and hash of the key.
+     * @param ofs The offset of the key to be verified.
+     *
+     * @return True if the key matches, False otherwise.
+     */
+    inline bool verify(const str key, const KeyMeta &meta,
+                       const int ofs) const {
+        return len == meta.len && hash == meta.hash && verify(key, ofs);
+    }
+
     /**
      * Compare the given key with the key of the kv_load.
      *
@@ -94,25 +116,20 @@ class kv {
      */
     inline bool part_verify(const str key, const int begin,
                             const int end) const {
-        for (int i = begin; i < end; ++i) {
-            if (key[i] != k[i]) {
-                return false;
-            }
-        }
-        return true;
+        return str_ncmp(key + begin, k + begin, end - begin) == 0;
     }
 
     /**
      * Get the size of the kv_load in bytes.
      *
      * This function returns the total size of the kv_load in bytes which
-     * includes the size of the key, the value and the null terminator of the
+     * includes the size of the header, the key and the null terminator of the
      * key.
      *
      * @return The size of the kv_load in bytes.
      */
     inline size_t _len() const {
-        size_t byte_sz = sizeof(uint64_t) + strlen(k) + 1;
+        size_t byte_sz = sizeof(kv) + len + 1;
         return byte_sz;
     }
 };
@@ -125,57 +142,59 @@ class kv {
  *
  * @param k The key of the new kv_pair.
  * @param v The value of the new kv_pair.
+ * @param meta The length and hash of the key.
  *
  * @return A pointer to the new kv_pair.
  */
+inline kv *new_kv(const str k, const uint64_t v, const KeyMeta &meta) {
+    size_t sz = sizeof(kv) + meta.len + 1; // +1 for null terminator
+    kv *kvload = (kv *)new uint8_t[sz];    // allocate memory
+    kvload->set(k, v, meta);               // set key and value
+    charge(&Counters::kv_bytes, sz);       // account the new kv_pair
+    charge(&Counters::kv_key_bytes, meta.len + 1);
+    return kvload;                         // return pointer to new kv_pair
+}
+
 inline kv *new_kv(const str k, const uint64_t v) {
-    size_t sz = sizeof(kv) + ustrlen(k) + 1; // +1 for null terminator
-    kv *kvload = (kv *)new uint8_t[sz];      // allocate memory
-    kvload->set(k, v);                       // set key and value
-    return kvload;                           // return pointer to new kv_pair
+    return new_kv(k, v, KeyMeta(k));
 }
 
 /**
- * Create a new kv_pair with a hash value embedded in the pointer.
+ * Create a new kv_pair with a hash value embedded in the pointer from an
+ * existing kv_pair.
  *
- * This function allocates memory for a new kv_pair, sets the key and value of
- * the new kv_pair and embeds the hash value of the key in the pointer to the
- * kv_pair. It returns a pointer to the new kv_pair.
+ * This function embeds the fingerprint of the key, which is read from the
+ * kv_pair's header, in the pointer to the kv_pair and returns it.
  *
- * @param k The key of the new kv_pair.
- * @param v The value of the new kv_pair.
+ * @param _kv The kv_pair to create a new kv_pair from.
  *
- * @return A pointer to the new kv_pair with the hash value embedded in the
+ * @return A pointer to the kv_pair with the hash value embedded in the
  *         pointer.
  */
-inline kv *new_hash_kv(const str k, const uint64_t v) {
-    kv *ret = new_kv(k, v);
-    uint64_t hash = hashStr(k);           // Calculate the hash value of the key
-    uint64_t ptr = (uint64_t)(void *)ret; // Get the pointer to the kv_pair
-    ptr = ptr | (hash << 48);             // Embed the hash value in the pointer
+inline kv *new_hash_kv(kv *_kv) {
+    uint64_t hash = fingerprint(_kv->hash); // The stored hash of the key
+    uint64_t ptr = (uint64_t)(void *)_kv;   // Get the pointer to the kv_pair
+    ptr = ptr | (hash << 48); // Embed the hash value in the pointer
     return (kv *)(void *)ptr; // Return the pointer to the kv_pair with the hash
                               // value embedded in it
 }
 
 /**
- * Create a new kv_pair with a hash value embedded in the pointer from an
- * existing kv_pair.
- *
- * This function creates a new kv_pair with a hash value embedded in the pointer
- * to the kv_pair. The hash value is calculated from the key of the given
- * kv_pair and the pointer to the new kv_pair is returned.
+ * Create a new kv_pair with a hash value embedded in the pointer.
  *
- * @param _kv The kv_pair to create a new kv_pair from.
+ * @param k The key of the new kv_pair.
+ * @param v The value of the new kv_pair.
+ * @param meta The length and hash of the key.
  *
  * @return A pointer to the new kv_pair with the hash value embedded in the
  *         pointer.
  */
-inline kv *new_hash_kv(kv *_kv) {
-    uint64_t hash = hashStr(_kv->k);      // Calculate the hash value of the key
-    uint64_t ptr = (uint64_t)(void *)_kv; // Get the pointer to the kv_pair
-    ptr = ptr | (hash << 48);             // Embed the hash value in the pointer
-    return (kv *)(void *)ptr; // Return the pointer to the kv_pair with the hash
-                              // value embedded in it
+inline kv *new_hash_kv(const str k, const uint64_t v, const KeyMeta &meta) {
+    return new_hash_kv(new_kv(k, v, meta));
+}
+
+inline kv *new_hash_kv(const str k, const uint64_t v) {
+    return new_hash_kv(new_kv(k, v));
 }
 
 /**
@@ -195,6 +214,15 @@ inline uint16_t getHashVal(const kv *ptr) {
     return (v >> 48) & 0xffff;          // Extract the hash value and return it
 }
 
+/**
+ * The hook called on every kv_pair about to be freed, NULL if none. The
+ * lookup cache uses it to drop the stale entries (see lits_cache.hpp).
+ */
+inline void (*&kvFreeHook())(const kv *) {
+    static void (*hook)(const kv *) = NULL;
+    return hook;
+}
+
 /**
  * @brief Destroy a kv_pair.
  *
@@ -205,6 +233,11 @@ inline uint16_t getHashVal(const kv *ptr) {
  */
 void free_kv(kv *kv_load) {
     kv *raw_kv = (kv *)PTR_RAW(kv_load); // Get the pointer to the raw kv_pair
+    if (kvFreeHook())
+        kvFreeHook()(raw_kv);
+    charge(&Counters::kv_bytes, -(int64_t)raw_kv->_len());
+    charge(&Counters::kv_key_bytes, -(int64_t)(raw_kv->len + 1));
+    count(&Counters::kv_frees);
     delete[] reinterpret_cast<uint8_t *>(
         raw_kv); // Delete the raw kv_pair from memory
 }
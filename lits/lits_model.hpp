@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lits_base.hpp"
+#include "lits_gpkl.hpp"
 
 #include <iostream>
 #include <xmmintrin.h>
@@ -15,20 +16,12 @@ class HPT {
     // Attenuation factor, should be in (0, 1]
     static constexpr double AF = 0.5;
 
-    // Position hash bits length
+    // The default position hash bits length
     static constexpr int PS_HASH_LEN = 5;
 
-    // Front char hash bits length
+    // The default front char hash bits length
     static constexpr int FC_HASH_LEN = 5;
 
-    // Position hash mask and front char hash mask
-    static constexpr uint32_t PS_MASK = (1 << PS_HASH_LEN) - 1;
-    static constexpr uint32_t FC_MASK = (1 << FC_HASH_LEN) - 1;
-
-    // Position array length and front char array length
-    static constexpr uint32_t PS_SZ = PS_MASK + 1;
-    static constexpr uint32_t FC_SZ = FC_MASK + 1;
-
     // Units in a table line
     class UNI {
       public:
@@ -40,29 +33,60 @@ class HPT {
         ~UNI() = default;
     };
 
-    // Hash-enhanced Prefix Table
-    UNI *m[PS_SZ][FC_SZ];
+  private:
+    // Position hash bits length and front char hash bits length
+    int ps_hash_len;
+    int fc_hash_len;
+
+    // Position hash mask and front char hash mask
+    uint32_t ps_mask;
+    uint32_t fc_mask;
+
+    // Position array length and front char array length
+    uint32_t ps_sz;
+    uint32_t fc_sz;
+
+  public:
+    // Hash-enhanced Prefix Table: one block of ps_sz * fc_sz lines of MAX_CH
+    // units, the line of position hash p and front char hash f at line
+    // (p << fc_hash_len) | f. A table entry takes a single load off m.
+    UNI *m;
 
   public:
-    HPT() {
+    HPT(const int _ps_hash_len = PS_HASH_LEN,
+        const int _fc_hash_len = FC_HASH_LEN)
+        : ps_hash_len(_ps_hash_len), fc_hash_len(_fc_hash_len) {
         // The table cannot be too large!
-        // ST_ASSERT((PS_HASH_LEN + FC_HASH_LEN) <= 12);
+        RT_ASSERT(ps_hash_len + fc_hash_len <= 15);
 
-        for (int i = 0; i < PS_SZ; ++i) {
-            for (int j = 0; j < FC_SZ; ++j) {
-                m[i][j] = new UNI[MAX_CH];
-            }
-        }
+        ps_mask = (1 << ps_hash_len) - 1;
+        fc_mask = (1 << fc_hash_len) - 1;
+        ps_sz = ps_mask + 1;
+        fc_sz = fc_mask + 1;
+        m = new UNI[ps_sz * fc_sz * MAX_CH];
     }
 
+    // A copy of a trained model, for an index split off another
+    HPT(const HPT &other) : HPT(other.ps_hash_len, other.fc_hash_len) {
+        std::copy(other.m, other.m + ps_sz * fc_sz * MAX_CH, m);
+    }
+
+    HPT &operator=(const HPT &) = delete;
+
     ~HPT() { destroy(); };
 
-    void destroy() {
-        for (int i = 0; i < PS_SZ; ++i) {
-            for (int j = 0; j < FC_SZ; ++j) {
-                delete[] m[i][j];
-            }
-        }
+    void destroy() { delete[] m; }
+
+    // The position and front char hash bits lengths
+    int ps_len() const { return ps_hash_len; }
+    int fc_len() const { return fc_hash_len; }
+
+    /**
+     * Return the table line of the byte at position i of a key, whose
+     * previous byte is prev.
+     */
+    inline const UNI *line(const int i, const char prev) const {
+        return m + offset(i, prev);
     }
 
     /**
@@ -73,16 +97,17 @@ class HPT {
     /**
      * Return the byte size of the model.
      */
-    size_t model_size() { return sizeof(UNI) * PS_SZ * FC_SZ * MAX_CH; }
+    size_t model_size() { return sizeof(UNI) * ps_sz * fc_sz * MAX_CH; }
 
     /**
      * Train the HPT.
      * @param keys The input keys.
      * @param len The input data size.
+     * @param adj The adjacent lcp table of keys, computed if not provided.
      *
      * @return true when success, false otherwise.
      */
-    bool train(const str *keys, const int len) {
+    bool train(const str *keys, const int len, const AdjLCP *adj = NULL) {
         // Variables
         double this_line_wgt;
         double weight[256];
@@ -102,7 +127,9 @@ class HPT {
             // We only consider the distinguishing prefix
             int max_len = 0;
 
-            if (i == 0)
+            if (adj)
+                max_len = adj->dlcp(i) + 1;
+            else if (i == 0)
                 max_len = ucpl(keys[0], keys[1]) + 1;
             else if (i == len - 1)
                 max_len = ucpl(keys[len - 1], keys[len - 2]) + 1;
@@ -111,36 +138,35 @@ class HPT {
                                         ucpl(keys[i], keys[i + 1])) +
                           1;
 
+            // The distinguishing prefix never exceeds the key itself
+            max_len = std::min<int>(ustrlen(keys[i]), max_len);
+
             // Record the occurance frequency in table
-            for (int b = gcpl; b < std::min<int>(ustrlen(keys[i]), max_len);
-                 ++b) {
+            for (int b = gcpl; b < max_len; ++b) {
                 dst_ch = keys[i][b];
-                int _ps = b & PS_MASK;
-                int _fc = b == 0 ? 0 : (keys[i][b - 1] & FC_MASK);
-                m[_ps][_fc][dst_ch].CDF += weight[b - gcpl];
+                char prev = b == 0 ? 0 : keys[i][b - 1];
+                m[offset(b, prev) + dst_ch].CDF += weight[b - gcpl];
             }
         }
 
         // Generate the cdf distribution from the frequency
-        for (int x = 0; x < PS_SZ; ++x) {
-            for (int y = 0; y < FC_SZ; ++y) {
-                this_line_wgt = 0;
-                for (int j = 0; j < MAX_CH; ++j) {
-                    this_line_wgt += m[x][y][j].CDF;
-                }
-                if (this_line_wgt <= 0)
-                    continue;
-                for (int j = 0; j < MAX_CH; ++j) {
-                    m[x][y][j].CDF /= this_line_wgt;
-                    m[x][y][j].PRO = m[x][y][j].CDF;
-                }
-                double sum = m[x][y][0].CDF;
-                m[x][y][0].CDF = 0;
-                for (int j = 1; j < MAX_CH; ++j) {
-                    double tmp = m[x][y][j].CDF;
-                    m[x][y][j].CDF = sum;
-                    sum += tmp;
-                }
+        for (UNI *l = m; l < m + ps_sz * fc_sz * MAX_CH; l += MAX_CH) {
+            this_line_wgt = 0;
+            for (int j = 0; j < MAX_CH; ++j) {
+                this_line_wgt += l[j].CDF;
+            }
+            if (this_line_wgt <= 0)
+                continue;
+            for (int j = 0; j < MAX_CH; ++j) {
+                l[j].CDF /= this_line_wgt;
+                l[j].PRO = l[j].CDF;
+            }
+            double sum = l[0].CDF;
+            l[0].CDF = 0;
+            for (int j = 1; j < MAX_CH; ++j) {
+                double tmp = l[j].CDF;
+                l[j].CDF = sum;
+                sum += tmp;
             }
         }
 
@@ -148,6 +174,14 @@ class HPT {
         return true;
     }
 
+  private:
+    // The first unit of the table line of line()
+    inline uint32_t offset(const int i, const char prev) const {
+        return (((i & ps_mask) << fc_hash_len) | (prev & fc_mask)) * MAX_CH;
+    }
+
+  public:
+
     /**
      * Get the position in the LITS node's item array.
      *
@@ -158,41 +192,85 @@ class HPT {
      * @param ssl Second Skip Length. Provided by one byte index.
      * @param k The local linear model's slope.
      * @param b The local linear model's intercept.
+     * @param end If not NULL, set to the length of the key prefix the
+     * position depends on (every key sharing it gets the same position).
      *
      * @return a integer which stands for key's position in the node array.
      */
     inline int getPos(const str key, const int size, int gcpl, double k = 1,
-                      double b = 0) const {
+                      double b = 0, int *end = NULL) const {
         double ps = size * k;
         double c = size * b;
 
-        for (int i = gcpl; key[i] && ps >= 1; ++i) {
-            const auto &uni = m[i & PS_MASK][key[i - 1] & FC_MASK][key[i]];
+        int i = gcpl;
+        for (; key[i] && ps >= 1; ++i) {
+            const auto &uni = line(i, key[i - 1])[key[i]];
             c += ps * uni.CDF;
             ps *= uni.PRO;
         }
+        if (end)
+            *end = key[i] ? i : i + 1;
 
         return static_cast<int>(c);
     }
 
     inline int getPos_woGCPL(const str key, const int size, double k = 1,
-                             double b = 0) const {
+                             double b = 0, int *end = NULL) const {
         double pro = size * k;
         double cdf = size * b;
 
-        const auto &uni = m[0][0][key[0]];
+        const auto &uni = line(0, 0)[key[0]];
         cdf += pro * uni.CDF;
         pro *= uni.PRO;
 
-        for (int i = 1; key[i] && pro >= 1; ++i) {
-            const auto &uni = m[i & PS_MASK][key[i - 1] & FC_MASK][key[i]];
+        int i = 1;
+        for (; key[i] && pro >= 1; ++i) {
+            const auto &uni = line(i, key[i - 1])[key[i]];
             cdf += pro * uni.CDF;
             pro *= uni.PRO;
         }
+        if (end)
+            *end = key[i] ? i : i + 1;
 
         return static_cast<int>(cdf);
     }
 
+    /**
+     * getPos (getPos_woGCPL if gcpl is 0), loading ahead the item array
+     * line(s) of the position as soon as it narrows to 8 slots (of 8 bytes
+     * from slots), while the last key bytes are evaluated.
+     *
+     * The table entries of the next key bytes are not loaded ahead: the
+     * address of each needs the load of its table line first, which cost
+     * more than the misses it saved.
+     */
+    inline int getPos_prefetch(const str key, const int size, int gcpl,
+                               double k, double b, const char *slots) const {
+        double ps = size * k;
+        double c = size * b;
+        int i = gcpl;
+        if (i == 0) {
+            const auto &uni = line(0, 0)[key[0]];
+            c += ps * uni.CDF;
+            ps *= uni.PRO;
+            i = 1;
+        }
+
+        bool narrowed = false;
+        for (; key[i] && ps >= 1; ++i) {
+            if (!narrowed && ps <= 8) {
+                LITS_PREFETCH_ADDR(slots + (int64_t)c * 8);
+                LITS_PREFETCH_ADDR(slots + (int64_t)(c + ps) * 8);
+                narrowed = true;
+            }
+            const auto &uni = line(i, key[i - 1])[key[i]];
+            c += ps * uni.CDF;
+            ps *= uni.PRO;
+        }
+
+        return static_cast<int>(c);
+    }
+
     /**
      * Return a CDF value of key which is NOT processed by the local model.
      */
@@ -200,8 +278,17 @@ class HPT {
         double pro = 1;
         double cdf = 0;
         static constexpr double min_double = 1. / (1UL << 52);
-        for (int i = gcpl; key[i] && pro >= min_double; ++i) {
-            const auto &uni = m[i & PS_MASK][key[i - 1] & FC_MASK][key[i]];
+        int i = gcpl;
+
+        // The first byte has no previous one (as in getPos_woGCPL)
+        if (i == 0 && key[0]) {
+            const auto &uni = line(0, 0)[key[0]];
+            cdf += uni.CDF;
+            pro *= uni.PRO;
+            i = 1;
+        }
+        for (; key[i] && pro >= min_double; ++i) {
+            const auto &uni = line(i, key[i - 1])[key[i]];
             cdf += pro * uni.CDF;
             pro *= uni.PRO;
         }
@@ -7,9 +7,11 @@
 #include "lits_iter.hpp"
 #include "lits_model.hpp"
 #include "lits_pmss.hpp"
+#include "lits_trace.hpp"
 
 #include <immintrin.h>
 #include <stack>
+#include <string>
 
 namespace lits {
 
@@ -121,8 +123,29 @@ class FlaggedPtr {
     inline void *raw() const { return (void *)(main_body & PTR_MASK); }
 };
 
+/**
+ * A model-based inner node: the header, the prefix and the item array.
+ *
+ * Compiled with -DLITS_ALIGNED_NODES, nodes are aligned to cache lines: the
+ * fields predictPos reads and the first prefix bytes share the first line,
+ * the item array starts on a line boundary, and num_of_keys, written by
+ * every insert and remove, takes a line of its own before it, apart from
+ * the lines the readers touch. This costs 80 bytes more per node without
+ * prefix, plus the padding of the item array to whole lines.
+ */
 class InnerNode {
   public:
+#ifdef LITS_ALIGNED_NODES
+    typedef struct {
+        double k; // linear model's slope
+        double b; // linear model's intercept
+        uint64_t item_array_length;
+        uint32_t prefix_length;
+        uint32_t header_offset;
+        float scale_factor; // item array slots per key when built
+        uint32_t radix;     // 1 if slots are the 2 bytes after the prefix
+    } header;
+#else
     typedef struct {
         uint64_t item_array_length;
         uint64_t num_of_keys;
@@ -130,7 +153,10 @@ class InnerNode {
         double b; // linear model's intercept
         uint32_t prefix_length;
         uint32_t header_offset;
+        float scale_factor; // item array slots per key when built
+        uint32_t radix;     // 1 if slots are the 2 bytes after the prefix
     } header;
+#endif
 
   public:
     header h;
@@ -143,6 +169,40 @@ class InnerNode {
     inline double get_K() const { return h.k; }
     inline double get_B() const { return h.b; }
     Item *get_items() { return (Item *)(get_prefix() + h.header_offset); }
+    inline bool is_radix() const { return h.radix; }
+
+    // The number of keys in the sub-trie of the node
+#ifdef LITS_ALIGNED_NODES
+    inline uint64_t &num_keys() {
+        return *(uint64_t *)(get_prefix() + h.header_offset - 64);
+    }
+#else
+    inline uint64_t &num_keys() { return h.num_of_keys; }
+#endif
+
+    /**
+     * Whether the node is to be resized when holding n keys: 4x or 1/2 of
+     * the keys it was built with (as sized by its scale factor). A radix
+     * node has a fixed size.
+     */
+    inline bool too_full(const uint64_t n) const {
+        return !h.radix && n * h.scale_factor >= 4 * h.item_array_length;
+    }
+    inline bool too_sparse(const uint64_t n) const {
+        return !h.radix && 2 * n * h.scale_factor <= h.item_array_length;
+    }
+
+    /**
+     * Return the size of a node with an icpl bytes prefix and len items,
+     * and set header_offset to the offset of its items from the prefix.
+     */
+    static inline uint64_t layout(const uint32_t icpl, const uint64_t len,
+                                  uint32_t &header_offset);
+
+    /**
+     * Return the size of the node (Bytes)
+     */
+    inline uint64_t node_size() const;
 };
 
 class Item {
@@ -182,6 +242,41 @@ class Item {
         return &(node->get_items()[pos]);
     }
 
+    /**
+     * Load ahead the first lines of the node, the kv entry or the HOT root
+     * the item points to (with LITS_PREFETCH), so that they arrive while the
+     * search into it hashes the key.
+     */
+    inline void prefetch() const {
+#ifdef LITS_PREFETCH
+        const char *p = (const char *)ptr.raw();
+        switch (get_itype()) {
+        case ITYP_Trie: {
+            // HOT nodes are prefetched by 4 lines, as HOT itself does
+            uint64_t coded_subtrie = get_coded_index();
+            p = (const char *)((HOTIndex &)coded_subtrie).mRoot.getNode();
+            LITS_PREFETCH_ADDR(p);
+            LITS_PREFETCH_ADDR(p + 64);
+            LITS_PREFETCH_ADDR(p + 128);
+            LITS_PREFETCH_ADDR(p + 192);
+            break;
+        }
+        case ITYP_CNod:
+            LITS_PREFETCH_ADDR(p);
+            LITS_PREFETCH_ADDR(p + 64);
+            LITS_PREFETCH_ADDR(p + 128);
+            break;
+        case ITYP_Mult:
+        case ITYP_Sing:
+            LITS_PREFETCH_ADDR(p);
+            LITS_PREFETCH_ADDR(p + 64);
+            break;
+        default:
+            break;
+        }
+#endif
+    }
+
     // recursive delete
     void recursive_extract(KVS1 &kvs) {
         switch (get_itype()) {
@@ -204,13 +299,364 @@ class Item {
         }
         case ITYP_Mult: {
             extract_inner_node(get_inner_node(), kvs);
-            delete[] reinterpret_cast<uint8_t *>(get_inner_node());
+            free_inner_node(get_inner_node());
             return;
         }
         }
     }
 };
 
+inline uint64_t InnerNode::layout(const uint32_t icpl, const uint64_t len,
+                                  uint32_t &header_offset) {
+#ifdef LITS_ALIGNED_NODES
+    uint64_t line = (sizeof(header) + icpl + 63) & ~63UL;
+    header_offset = line + 64 - sizeof(header);
+    return line + 64 + ((len * sizeof(Item) + 63) & ~63UL);
+#else
+    header_offset = icpl + ((icpl % 8) ? (8 - (icpl % 8)) : 0);
+    return sizeof(header) + header_offset + len * sizeof(Item);
+#endif
+}
+
+inline uint64_t InnerNode::node_size() const {
+    uint32_t offset;
+    return layout(h.prefix_length, h.item_array_length, offset);
+}
+
+/**
+ * Allocate the space of an inner node zeroed (cache line aligned with
+ * LITS_ALIGNED_NODES), and free it.
+ */
+inline InnerNode *alloc_inner_node(const uint64_t space) {
+#ifdef LITS_ALIGNED_NODES
+    void *node = aligned_alloc(64, space);
+#else
+    void *node = new uint8_t[space];
+#endif
+    memset(node, 0, space);
+    return (InnerNode *)node;
+}
+
+inline void dealloc_inner_node(InnerNode *node) {
+#ifdef LITS_ALIGNED_NODES
+    free(node);
+#else
+    delete[] reinterpret_cast<uint8_t *>(node);
+#endif
+}
+
+/**
+ * Collect the statistics of the sub-trie rooted at item, which is reached
+ * after passing depth inner nodes.
+ *
+ * @return the number of keys in the sub-trie
+ */
+uint64_t collect_stats(const Item &item, const int depth, Stats &s) {
+    switch (item.get_itype()) {
+    case ITYP_Sing: {
+        s.num_sing++;
+        s.kv_bytes += item.get_entry()->_len();
+        s.add_keys(depth, 1);
+        return 1;
+    }
+    case ITYP_CNod: {
+        Cnode *cnode = item.get_cnode();
+        s.num_cnod++;
+        s.cnode_bytes += cnode->cnode_size();
+        for (int i = 0; i < cnode->h.key_cnt; ++i) {
+            s.kv_bytes += RAW_KV(cnode->data[i])->_len();
+        }
+        s.add_keys(depth, cnode->h.key_cnt);
+        return cnode->h.key_cnt;
+    }
+    case ITYP_Trie: {
+        uint64_t coded_subtrie = item.get_coded_index();
+        auto &hot = ((HOTIndex &)coded_subtrie);
+        uint64_t n = 0;
+        for (auto it = hot.begin(); it != HOTIndex::END_ITERATOR; ++it) {
+            s.kv_bytes += (*it).getKV()->_len();
+            n++;
+        }
+        s.num_trie++;
+        s.hot_bytes += hot.getStatistics().first;
+        s.add_keys(depth, n);
+        return n;
+    }
+    case ITYP_Mult: {
+        InnerNode *node = item.get_inner_node();
+        Item *item_array = node->get_items();
+        uint64_t len = node->get_item_array_len(), n = 0, used = 0;
+        for (int i = 0; i < len; ++i) {
+            if (item_array[i].is_empty())
+                continue;
+            used++;
+            n += collect_stats(item_array[i], depth + 1, s);
+        }
+        Stats::level &l = s.get_level(depth);
+        l.nodes++;
+        l.slots += len;
+        l.used_slots += used;
+        l.keys += n;
+        s.num_mult++;
+        s.inner_bytes += node->node_size();
+        return n;
+    }
+    }
+    return 0;
+}
+
+/**
+ * Add the live bytes of the sub-trie of item to c, as they were charged.
+ */
+void measure_bytes(const Item &item, Counters &c) {
+    switch (item.get_itype()) {
+    case ITYP_Sing: {
+        kv *entry = item.get_entry();
+        c.kv_bytes += entry->_len();
+        c.kv_key_bytes += entry->len + 1;
+        return;
+    }
+    case ITYP_CNod: {
+        Cnode *cnode = item.get_cnode();
+        c.cnode_bytes += cnode->cnode_size();
+        c.cnode_header_bytes += sizeof(Cnode::cheader);
+        for (int i = 0; i < cnode->h.key_cnt; ++i) {
+            kv *entry = RAW_KV(cnode->data[i]);
+            c.kv_bytes += entry->_len();
+            c.kv_key_bytes += entry->len + 1;
+        }
+        return;
+    }
+    case ITYP_Trie: {
+        uint64_t coded_subtrie = item.get_coded_index();
+        auto &hot = ((HOTIndex &)coded_subtrie);
+        for (auto it = hot.begin(); it != HOTIndex::END_ITERATOR; ++it) {
+            kv *entry = (*it).getKV();
+            c.kv_bytes += entry->_len();
+            c.kv_key_bytes += entry->len + 1;
+        }
+        c.hot_bytes += hot.getStatistics().first;
+        return;
+    }
+    case ITYP_Mult: {
+        InnerNode *node = item.get_inner_node();
+        Item *item_array = node->get_items();
+        uint64_t len = node->get_item_array_len();
+        for (int i = 0; i < len; ++i) {
+            measure_bytes(item_array[i], c);
+        }
+        c.inner_bytes += node->node_size();
+        c.inner_header_bytes +=
+            sizeof(InnerNode::header) + node->h.header_offset;
+        return;
+    }
+    }
+}
+
+/**
+ * Return the kv entry of the smallest (or, if last, the largest) key in the
+ * sub-trie of item, NULL if it is empty.
+ */
+kv *edge_entry(const Item &item, const bool last) {
+    switch (item.get_itype()) {
+    case ITYP_Sing: {
+        return item.get_entry();
+    }
+    case ITYP_CNod: {
+        Cnode *cnode = item.get_cnode();
+        return RAW_KV(cnode->data[last ? cnode->h.key_cnt - 1 : 0]);
+    }
+    case ITYP_Trie: {
+        // The HOT iterator only goes forward
+        uint64_t coded_subtrie = item.get_coded_index();
+        auto &hot = ((HOTIndex &)coded_subtrie);
+        kv *ret = NULL;
+        for (auto it = hot.begin(); it != HOTIndex::END_ITERATOR; ++it) {
+            ret = (*it).getKV();
+            if (!last)
+                break;
+        }
+        return ret;
+    }
+    case ITYP_Mult: {
+        InnerNode *node = item.get_inner_node();
+        Item *item_array = node->get_items();
+        int len = node->get_item_array_len();
+        for (int i = 0; i < len; ++i) {
+            const Item &child = item_array[last ? len - 1 - i : i];
+            if (!child.is_empty())
+                return edge_entry(child, last);
+        }
+        return NULL;
+    }
+    }
+    return NULL;
+}
+
+/**
+ * Return the number of keys in the sub-trie of item, HOT sub-tries counted
+ * up to limit only (they are walked).
+ */
+uint64_t count_keys(const Item &item, const uint64_t limit = UINT64_MAX) {
+    switch (item.get_itype()) {
+    case ITYP_Sing:
+        return 1;
+    case ITYP_CNod:
+        return item.get_cnode()->h.key_cnt;
+    case ITYP_Mult:
+        return item.get_inner_node()->num_keys();
+    case ITYP_Trie: {
+        uint64_t coded_subtrie = item.get_coded_index();
+        auto &hot = ((HOTIndex &)coded_subtrie);
+        uint64_t n = 0;
+        for (auto it = hot.begin(); it != HOTIndex::END_ITERATOR && n < limit;
+             ++it)
+            n++;
+        return n;
+    }
+    default:
+        return 0;
+    }
+}
+
+// ************************************************************
+//                      Rebuild Events
+// ************************************************************
+
+typedef enum {
+    // A model-based inner node on the path is rebuilt on resize
+    REB_PathRebuild = 0,
+    // A full Cnode is re-bulk loaded as a model-based node or HOT
+    REB_CnodePromote,
+    // A single entry is converted into a Cnode of 2 keys
+    REB_SingToCnode,
+    // A Cnode of 2 keys is degraded into a single entry
+    REB_CnodeToSing,
+} RebuildKind;
+
+/**
+ * A structural rebuild or conversion of a sub-trie.
+ */
+class RebuildEvent {
+  public:
+    RebuildKind kind;
+    int depth;         // inner nodes above the sub-trie
+    int keys;          // keys in the new sub-trie
+    ItemType old_type; // item type before
+    ItemType new_type; // item type after
+    SubTrieType styp;  // sub-trie type of the new item
+    double seconds;    // wall time spent
+};
+
+/**
+ * Interface of the rebuild listener, see LITS::set_rebuild_listener. It is
+ * called synchronously by the thread doing the write.
+ */
+class RebuildListener {
+  public:
+    virtual ~RebuildListener() = default;
+    virtual void on_rebuild(const RebuildEvent &e) = 0;
+};
+
+/**
+ * Return the sub-trie type of the item type, single entries count as Cnode.
+ */
+inline SubTrieType subTypeOf(const ItemType t) {
+    switch (t) {
+    case ITYP_Mult:
+        return STYP_Items;
+    case ITYP_Trie:
+        return STYP_Trie;
+    default:
+        return STYP_Cnode;
+    }
+}
+
+/**
+ * Rebuild the model-based inner node held by father, reached at depth with
+ * ccpl bytes confirmed, by bulk loading its keys again (or free it if it has
+ * none left), and report it as a path rebuild.
+ */
+inline void rebuild_inner_node(Item *father, const int ccpl, const int depth,
+                               const HPT *hpt, const PMSS *pmss,
+                               RebuildListener *listener) {
+    KVS1 kvs;
+    double t0 = listener ? nowSec() : 0;
+    count(&Counters::path_rebuilds);
+    LITS_TRACE_EVENT(TEV_PathRebuild);
+    father->recursive_extract(kvs);
+    int cnt = kvs.getSize();
+    if (cnt == 0)
+        father->set_null();
+    else
+        *father = pmss_bulk(kvs, 0, cnt, ccpl, hpt, pmss);
+
+    if (listener) {
+        RebuildEvent e;
+        e.kind = REB_PathRebuild;
+        e.depth = depth;
+        e.keys = cnt;
+        e.old_type = ITYP_Mult;
+        e.new_type = father->get_itype();
+        e.styp = subTypeOf(e.new_type);
+        e.seconds = nowSec() - t0;
+        listener->on_rebuild(e);
+    }
+}
+
+/**
+ * Watch the leaf item of a write, and report its conversion (if any) to the
+ * listener on destruction. Does nothing without a listener.
+ */
+class RebuildWatch {
+  private:
+    RebuildListener *listener;
+    const Item *item;
+    int depth;
+    ItemType old_type;
+    int old_keys;
+    double t0;
+
+  public:
+    RebuildWatch(RebuildListener *_listener, const Item *_item,
+                 const int _depth)
+        : listener(_listener) {
+        if (unlikely(listener != NULL)) {
+            item = _item;
+            depth = _depth;
+            old_type = item->get_itype();
+            old_keys = old_type == ITYP_CNod ? item->get_cnode()->h.key_cnt : 1;
+            t0 = nowSec();
+        }
+    }
+
+    ~RebuildWatch() {
+        if (likely(listener == NULL))
+            return;
+        ItemType new_type = item->get_itype();
+        RebuildEvent e;
+        if (old_type == ITYP_CNod &&
+            (new_type == ITYP_Mult || new_type == ITYP_Trie)) {
+            e.kind = REB_CnodePromote;
+            e.keys = old_keys + 1;
+        } else if (old_type == ITYP_Sing && new_type == ITYP_CNod) {
+            e.kind = REB_SingToCnode;
+            e.keys = 2;
+        } else if (old_type == ITYP_CNod && new_type == ITYP_Sing) {
+            e.kind = REB_CnodeToSing;
+            e.keys = 1;
+        } else {
+            return;
+        }
+        e.depth = depth;
+        e.old_type = old_type;
+        e.new_type = new_type;
+        e.styp = subTypeOf(new_type);
+        e.seconds = nowSec() - t0;
+        listener->on_rebuild(e);
+    }
+};
+
 class PathStack {
   private:
     typedef struct {
@@ -222,12 +668,49 @@ class PathStack {
   private:
     HPT *hpt;
     PMSS *pmss;
+    RebuildListener *listener;
     int stack_op = 0;
     path p[MAX_STACK];
 
   public:
     PathStack() = delete;
-    PathStack(HPT *_hpt, PMSS *_pmss) : hpt(_hpt), pmss(_pmss) {}
+    PathStack(HPT *_hpt, PMSS *_pmss, RebuildListener *_listener = NULL)
+        : hpt(_hpt), pmss(_pmss), listener(_listener) {}
+
+    // The number of inner nodes recorded
+    inline int depth() const { return stack_op; }
+
+    // The father item and the ccpl of the i-th inner node recorded
+    inline Item *father(const int i) const { return p[i].father; }
+    inline int ccpl(const int i) const { return p[i].ccpl; }
+
+    // Drop the inner nodes recorded from the i-th on
+    inline void truncate(const int i) { stack_op = i; }
+
+    /**
+     * Forget the path, and bind the model, the PMSS and the listener used by
+     * the rebuilds of the next one.
+     */
+    inline void reset(HPT *_hpt, PMSS *_pmss, RebuildListener *_listener) {
+        hpt = _hpt;
+        pmss = _pmss;
+        listener = _listener;
+        stack_op = 0;
+    }
+
+    /**
+     * Whether the path, ending at the leaf item, leaves every inner node
+     * through one of its last two slots.
+     */
+    bool is_rightmost(const Item *leaf) const {
+        for (int i = 0; i < stack_op; ++i) {
+            const Item *child = i + 1 < stack_op ? p[i + 1].father : leaf;
+            if (child - p[i].header->get_items() <
+                (int64_t)p[i].header->get_item_array_len() - 2)
+                return false;
+        }
+        return true;
+    }
 
     inline void record_path(Item *item, int ccpl) {
         p[stack_op].header = item->get_inner_node();
@@ -237,35 +720,84 @@ class PathStack {
     }
 
     /**
-     * Only happens after a valid insertion.
-     * Increase the #keys from root to leaf
+     * Only happens after a valid insertion (or removal, or merge).
+     * Add _cnt to the #keys from root to leaf
      *
      * If detect a resize boundary, do resize
+     *
+     * @return the depth of the rebuilt inner node, whose father now holds the
+     *         new sub-trie, -1 if none
      */
-    void change_num(int _cnt) {
+    int change_num(int _cnt) {
         for (int i = 0; i < stack_op; ++i) {
-            if (_cnt > 0)
-                p[i].header->h.num_of_keys++;
-            else
-                p[i].header->h.num_of_keys--;
+            uint64_t &num = p[i].header->num_keys();
+            num += (int64_t)_cnt;
 
             // Possible resize
-            if ((p[i].header->h.num_of_keys >=
-                 2 * p[i].header->h.item_array_length) ||
-                (4 * p[i].header->h.num_of_keys <=
-                 p[i].header->h.item_array_length)) {
-                KVS1 kvs;
-                int cnt = p[i].header->h.num_of_keys;
-                p[i].father->recursive_extract(kvs);
-                Item new_item = pmss_bulk(kvs, 0, cnt, p[i].ccpl, hpt, pmss);
-
-                *(p[i].father) = new_item;
-                return;
+            if (p[i].header->too_full(num) || p[i].header->too_sparse(num)) {
+                rebuild_inner_node(p[i].father, p[i].ccpl, i, hpt, pmss,
+                                   listener);
+                return i;
             }
         }
+        return -1;
+    }
+};
+
+/**
+ * The path of the last insert, kept while it leaves every inner node through
+ * one of its last two slots. predictPos is monotone in the key, so a greater
+ * key sharing the ccpl of the leaf with the last one lands on the same leaf:
+ * a run of appends resumes from there instead of descending from the root.
+ */
+class AppendCursor {
+  public:
+    PathStack stack;
+    Item *leaf = NULL; // NULL if the path is not kept
+    int ccpl = 0;      // the ccpl of the leaf
+    std::string last_key;
+
+  public:
+    AppendCursor() : stack(NULL, NULL) {}
+
+    /**
+     * Whether the key lands on the kept leaf.
+     */
+    inline bool accepts(const str key) const {
+        str last = (str)last_key.c_str();
+        return leaf != NULL && ustrcmp(key, last) > 0 &&
+               ucpl(key, last) >= ccpl;
+    }
+
+    /**
+     * Keep the path of stack, ending at the leaf item reached with the key.
+     */
+    inline void keep(Item *_leaf, const int _ccpl, const str key) {
+        if (!stack.is_rightmost(_leaf)) {
+            invalidate();
+            return;
+        }
+        leaf = _leaf;
+        ccpl = _ccpl;
+        last_key.assign(key);
     }
+
+    inline void invalidate() { leaf = NULL; }
 };
 
+// The item array length of a radix node: a slot per first two bytes after
+// the prefix, and the two boundary slots
+const int radix_array_length = MAX_CH * MAX_CH + 2;
+
+/**
+ * The slot of a radix node for the key bytes after its prefix, monotone in
+ * the key: the second byte only counts if the first is not the terminator.
+ */
+inline int radixPos(const str key) {
+    uint8_t c0 = key[0];
+    return 1 + c0 * MAX_CH + (c0 ? (uint8_t)key[1] : 0);
+}
+
 inline int predictPos(InnerNode *node, str key, int &ccpl, const HPT *model) {
     // The possible prefix
     str prefix = (str)(node->get_prefix());
@@ -286,8 +818,20 @@ inline int predictPos(InnerNode *node, str key, int &ccpl, const HPT *model) {
         }
     }
 
+    // A radix node dispatches on the next two bytes
+    if (unlikely(node->is_radix())) {
+        ccpl += icpl;
+        return radixPos(key + ccpl);
+    }
+
     // The position predicted by Bigram
     int pos;
+#ifdef LITS_PREFETCH
+    pos = model->getPos_prefetch(key, node->get_item_array_len() - 2,
+                                 ccpl + icpl, node->get_K(), node->get_B(),
+                                 (const char *)(node->get_items() + 1)) +
+          1;
+#else
     if (ccpl + icpl) {
         pos = model->getPos(key, node->get_item_array_len() - 2, ccpl + icpl,
                             node->get_K(), node->get_B()) +
@@ -297,6 +841,7 @@ inline int predictPos(InnerNode *node, str key, int &ccpl, const HPT *model) {
                                    node->get_K(), node->get_B()) +
               1;
     }
+#endif
 
     // Increase the confirmed common prefix length
     ccpl += icpl;
@@ -305,6 +850,71 @@ inline int predictPos(InnerNode *node, str key, int &ccpl, const HPT *model) {
     return std::max<int>(std::min<int>(pos, node->get_item_array_len() - 2), 1);
 }
 
+/**
+ * predictPos, also setting plen to the length of the key prefix the position
+ * depends on: every key sharing it with key is predicted into the same slot.
+ */
+inline int predictPos(InnerNode *node, str key, int &ccpl, const HPT *model,
+                      int &plen) {
+    str prefix = (str)(node->get_prefix());
+    uint32_t icpl = node->get_prefix_length();
+
+    // A mismatch with the common prefix decides a boundary slot, on the
+    // bytes up to the first differing one
+    if (icpl) {
+        int cmp_res = ustrcmp(prefix, key + ccpl, icpl);
+        if (cmp_res) {
+            int i = 0;
+            while (prefix[i] == key[ccpl + i])
+                i++;
+            plen = ccpl + i + 1;
+            return cmp_res == -1 ? node->get_item_array_len() - 1 : 0;
+        }
+    }
+
+    if (unlikely(node->is_radix())) {
+        ccpl += icpl;
+        plen = ccpl + (key[ccpl] ? 2 : 1);
+        return radixPos(key + ccpl);
+    }
+
+    int pos, end;
+    if (ccpl + icpl) {
+        pos = model->getPos(key, node->get_item_array_len() - 2, ccpl + icpl,
+                            node->get_K(), node->get_B(), &end) +
+              1;
+    } else {
+        pos = model->getPos_woGCPL(key, node->get_item_array_len() - 2,
+                                   node->get_K(), node->get_B(), &end) +
+              1;
+    }
+    ccpl += icpl;
+    plen = std::max<int>(end, ccpl);
+
+    return std::max<int>(std::min<int>(pos, node->get_item_array_len() - 2), 1);
+}
+
+/**
+ * Return a new inner node with the header, prefix and model of node, and an
+ * empty item array, for a split to move the slots of one side into.
+ */
+InnerNode *copy_inner_node_shell(const InnerNode *node) {
+    uint64_t space = node->node_size();
+    uint64_t head = sizeof(InnerNode::header) + node->h.header_offset;
+    InnerNode *ret = alloc_inner_node(space);
+    memcpy(ret, node, head);
+    charge(&Counters::inner_bytes, space);
+    charge(&Counters::inner_header_bytes, head);
+    return ret;
+}
+
+void free_inner_node(InnerNode *node) {
+    charge(&Counters::inner_bytes, -(int64_t)node->node_size());
+    charge(&Counters::inner_header_bytes,
+           -(int64_t)(sizeof(InnerNode::header) + node->h.header_offset));
+    dealloc_inner_node(node);
+}
+
 void extract_inner_node(InnerNode *node, KVS1 &kvs) {
     Item *item_array = node->get_items();
     uint64_t item_array_length = node->get_item_array_len();
@@ -313,18 +923,24 @@ void extract_inner_node(InnerNode *node, KVS1 &kvs) {
     }
 }
 
-// Build an inner node
+// The most keys sampled to choose the scale factor of an inner node
+const int max_scale_samples = 1024;
+
+// Build an inner node, on failure return NULL and tell why (if asked)
 template <class records>
 InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
                                      const int r, const int ccpl,
-                                     const HPT *model, const PMSS *pmss) {
+                                     const HPT *model, const PMSS *pmss,
+                                     ModelFail *why = NULL) {
     // Variables
+    ModelFail reason;
     int size;
     uint64_t item_array_length, space;
     uint32_t gcpl, icpl, space_for_pfx;
     InnerNode *new_node;
     Item *item_array;
-    double min_cdf, max_cdf, k, b;
+    double min_cdf, max_cdf, k, b, scale;
+    std::vector<double> sample;
     int lastIdx, _r_begin, _r_len, tmp_ccpl1, tmp_ccpl2, first_key_idx,
         final_key_idx;
     bool invalid_branch;
@@ -340,42 +956,50 @@ InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
     // The number of bulk load keys
     size = (r - l);
 
-    // Determine the sparse item array length
-    item_array_length = size * ScaleFactor;
-
     // Determine the global common prefix length
     gcpl = ucpl(kvs[l].k, kvs[r - 1].k);
 
     // Determine the incremental common prefix length
     icpl = gcpl - ccpl;
 
-    // Record the space needed for prefix, padding the space to 8x
-    space_for_pfx = (icpl + ((icpl % 8) ? (8 - (icpl % 8)) : 0));
-
-    // The total space needed for this node (paralled with 8)
-    space = sizeof(InnerNode::header)           // space for fix-sized header
-            + space_for_pfx                     // space for prefix
-            + item_array_length * sizeof(Item); // space for sparse item array
-
-    // The new model-based inner node
-    new_node = (InnerNode *)new uint8_t[space];
-    memset(new_node, 0, space);
-
     // The new node's intercept and slope
+    new_node = NULL;
     min_cdf = model->getCdf(kvs[l].k, gcpl);
     max_cdf = model->getCdf(kvs[r - 1].k, gcpl);
-    if (max_cdf <= min_cdf)
+    if (max_cdf <= min_cdf) {
+        reason = MFAIL_FlatCDF;
         goto FAIL_TO_BULK;
+    }
     k = 1. / (max_cdf - min_cdf);
     b = min_cdf / (min_cdf - max_cdf);
 
+    // Determine the sparse item array length, by a dry-run distribution of
+    // evenly spaced sample keys if the node may choose its scale factor
+    scale = pmss->scale_factor;
+    if (pmss->scale_budget >= 1) {
+        int step = std::max(1, size / max_scale_samples);
+        for (int i = l; i < r; i += step) {
+            sample.push_back(k * model->getCdf(kvs[i].k, gcpl) + b);
+        }
+        scale = pmss->decideScaleFactor(sample);
+    }
+    item_array_length = std::max<uint64_t>(size * scale, 3);
+
+    // The total space needed for this node, and the space for the prefix
+    // (padded) before the sparse item array
+    space = InnerNode::layout(icpl, item_array_length, space_for_pfx);
+
+    // The new model-based inner node
+    new_node = alloc_inner_node(space);
+
     // Set the fields
     new_node->h.item_array_length = item_array_length;
-    new_node->h.num_of_keys = size;
     new_node->h.k = k;
     new_node->h.b = b;
     new_node->h.prefix_length = icpl;
     new_node->h.header_offset = space_for_pfx;
+    new_node->h.scale_factor = scale;
+    new_node->num_keys() = size;
     memcpy(new_node->get_prefix(), kvs[l].k + ccpl, icpl);
 
     // The begin address of the sparse item array
@@ -383,6 +1007,8 @@ InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
 
     // Variables in the iteration
     lastIdx = -1;
+    _r_begin = l;
+    _r_len = 0;
     invalid_branch = false;
 
     // Before distribution, we need to clarify the model can discriminate
@@ -395,6 +1021,7 @@ InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
     // If the first key and last key cannot be discriminated, fail to build an
     // model-based inner node
     if (first_key_idx >= final_key_idx) {
+        reason = MFAIL_Indiscernible;
         goto FAIL_TO_BULK;
     }
 
@@ -415,6 +1042,7 @@ InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
         // Make sure the indexes are monotonic and valid
         if (idx < lastIdx || idx < 0 || idx >= item_array_length) {
             invalid_branch = true;
+            reason = MFAIL_Reversed;
             goto FAIL_TO_BULK;
         }
 
@@ -442,6 +1070,7 @@ InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
     // CDF are reversed or over boundary due to model imprecision
     // This case rarely happenes in almost every datasets
     if (invalid_branch) {
+        reason = MFAIL_Reversed;
         goto FAIL_TO_BULK;
     } else {
         // Handle the remain part
@@ -455,14 +1084,163 @@ InnerNode *_try_rebulk_as_model_node(const records &kvs, const int l,
                       model, pmss);
     }
 
+    charge(&Counters::inner_bytes, space);
+    charge(&Counters::inner_header_bytes,
+           sizeof(InnerNode::header) + space_for_pfx);
     return new_node;
 
 FAIL_TO_BULK:
 
-    delete[] reinterpret_cast<uint8_t *>(new_node);
+    count(failCounter(reason));
+    if (why)
+        *why = reason;
+    dealloc_inner_node(new_node);
     return NULL;
 }
 
+/**
+ * Build a radix node over the keys [l, r), dispatching on the two bytes
+ * after their common prefix to a sub-trie per non-empty slot, bulk loaded
+ * by pmss_bulk.
+ */
+template <class records>
+InnerNode *bulk_radix_node(const records &kvs, const int l, const int r,
+                           const int ccpl, const HPT *model,
+                           const PMSS *pmss) {
+    uint32_t gcpl = ucpl(kvs[l].k, kvs[r - 1].k);
+    uint32_t icpl = gcpl - ccpl;
+    uint32_t space_for_pfx;
+    uint64_t space =
+        InnerNode::layout(icpl, radix_array_length, space_for_pfx);
+
+    InnerNode *new_node = alloc_inner_node(space);
+    new_node->h.item_array_length = radix_array_length;
+    new_node->h.prefix_length = icpl;
+    new_node->h.header_offset = space_for_pfx;
+    new_node->h.radix = 1;
+    new_node->num_keys() = r - l;
+    memcpy(new_node->get_prefix(), kvs[l].k + ccpl, icpl);
+
+    // The keys of a slot are consecutive
+    Item *item_array = new_node->get_items();
+    int i = l, pos = radixPos(kvs[l].k + gcpl);
+    while (i < r) {
+        int j = i + 1, next = pos;
+        for (; j < r; ++j) {
+            next = radixPos(kvs[j].k + gcpl);
+            if (next != pos)
+                break;
+        }
+        item_array[pos] = pmss_bulk(kvs, i, j, gcpl, model, pmss);
+        i = j;
+        pos = next;
+    }
+
+    charge(&Counters::inner_bytes, space);
+    charge(&Counters::inner_header_bytes,
+           sizeof(InnerNode::header) + space_for_pfx);
+    return new_node;
+}
+
+// The most keys sampled to estimate the cost of a radix node
+const int max_radix_samples = 4096;
+
+// The cost of descending a level (a cache miss on its slot), in HPT steps
+const double level_miss_cost = 8;
+
+/**
+ * The lookup cost below the slots of a node of size keys, predicted in
+ * steps HPT steps: the keys of a sorted sample sharing a slot (est keys
+ * each per sample key in it) descend a level more, predicted in steps_per_bit
+ * HPT steps less per halving of the keys.
+ */
+inline double shared_slot_cost(const std::vector<int> &slots, const double est,
+                               const int size, const double steps,
+                               const double steps_per_bit) {
+    double cost = 0;
+    int m = slots.size();
+    for (int i = 0, j; i < m; i = j) {
+        for (j = i + 1; j < m && slots[j] == slots[i]; ++j)
+            ;
+        double keys = (j - i) * est;
+        if (keys > 1)
+            cost += (j - i) *
+                    (level_miss_cost +
+                     std::max(1., steps - steps_per_bit * log2(size / keys)));
+    }
+    return cost / m;
+}
+
+/**
+ * Whether a radix node over the keys [l, r) is estimated cheaper to descend
+ * than a model-based one, from evenly spaced sample keys. The model-based
+ * node costs the HPT steps of its prediction more, while the radix node
+ * usually has more keys sharing a slot, each descending a level more.
+ */
+template <class records>
+bool radix_node_pays(const records &kvs, const int l, const int r,
+                     const HPT *model, const PMSS *pmss) {
+    int size = r - l;
+    int gcpl = ucpl(kvs[l].k, kvs[r - 1].k);
+    double min_cdf = model->getCdf(kvs[l].k, gcpl);
+    double max_cdf = model->getCdf(kvs[r - 1].k, gcpl);
+
+    // Every model-based node fails on a flat CDF
+    if (max_cdf <= min_cdf)
+        return radixPos(kvs[l].k + gcpl) != radixPos(kvs[r - 1].k + gcpl);
+
+    double k = 1. / (max_cdf - min_cdf);
+    double b = min_cdf / (min_cdf - max_cdf);
+    int64_t len = (int64_t)size * pmss->scale_factor;
+
+    // The sample slots of both nodes, the model-based ones at the sample
+    // density, and the HPT steps of the model-based node and of one with
+    // 1/64 of its slots
+    std::vector<int> slots, buckets;
+    double steps = 0, fewer_steps = 0;
+    int step = std::max(1, size / max_radix_samples);
+    for (int i = l; i < r; i += step) {
+        str key = kvs[i].k;
+        int end, end_64, pos;
+        if (gcpl) {
+            pos = model->getPos(key, len - 2, gcpl, k, b, &end);
+            model->getPos(key, len / 64, gcpl, k, b, &end_64);
+        } else {
+            pos = model->getPos_woGCPL(key, len - 2, k, b, &end);
+            model->getPos_woGCPL(key, len / 64, k, b, &end_64);
+        }
+        steps += end - gcpl;
+        fewer_steps += end_64 - gcpl;
+        slots.push_back(pos / step);
+        buckets.push_back(radixPos(key + gcpl));
+    }
+    int m = slots.size();
+    steps /= m;
+    fewer_steps /= m;
+
+    double steps_per_bit = (steps - fewer_steps) / 6;
+    double model_cost =
+        steps + shared_slot_cost(slots, 1, size, steps, steps_per_bit);
+    double radix_cost = shared_slot_cost(buckets, (double)size / m, size,
+                                         steps, steps_per_bit);
+    return radix_cost < model_cost;
+}
+
+/**
+ * getGPKL, charging the time spent to the bound counters if they are
+ * collecting the phases of a bulk load.
+ */
+template <class records>
+inline double timedGPKL(const records &kvs, const int l, const int r) {
+    Counters *c = activeCounters();
+    if (c == NULL || !c->timing_phases)
+        return getGPKL(kvs, l, r);
+    double t0 = nowSec();
+    double gpkl = getGPKL(kvs, l, r);
+    charge(&Counters::gpkl_ns, (nowSec() - t0) * 1e9);
+    return gpkl;
+}
+
 template <class records>
 Item pmss_bulk(const records &kvs, const int l, const int r, const int ccpl,
                const HPT *model, const PMSS *pmss) {
@@ -479,15 +1257,17 @@ Item pmss_bulk(const records &kvs, const int l, const int r, const int ccpl,
     }
 
     // Case 2: bulk load as compact leaf node
-    else if (size <= CNODE_SIZE) {
+    else if (size <= pmss->cnode_size) {
+        count(&Counters::cnode_builds);
         item.set_cnode(new_cnode(kvs, l, r, ccpl));
         return item;
     }
 
     // Case 3: bulk load as model-based node
-    else if (pmss->decideSubType(size, getGPKL(kvs, l, r)) == STYP_Items) {
+    else if (pmss->decideSubType(size, timedGPKL(kvs, l, r)) == STYP_Items) {
         auto child = _try_rebulk_as_model_node(kvs, l, r, ccpl, model, pmss);
         if (child) {
+            count(&Counters::model_builds);
             item.set_inner_node(child);
             return item;
         }
@@ -495,9 +1275,13 @@ Item pmss_bulk(const records &kvs, const int l, const int r, const int ccpl,
 
     // Case 4: bulk load as sub-trie node
     {
-        HOTIndex *subtrie = new HOTIndex;
-        HOTBulkload(*subtrie, kvs, l, r);
-        item.set_coded_index(*subtrie);
+        count(&Counters::hot_builds);
+        // The HOT handle is the root pointer the item stores: build it in
+        // place, nothing is left to free
+        uint64_t coded_subtrie;
+        HOTIndex &subtrie = *new (&coded_subtrie) HOTIndex;
+        HOTBulkload(subtrie, kvs, l, r);
+        item.set_coded_index(subtrie);
 
         return item;
     }
@@ -505,6 +1289,111 @@ Item pmss_bulk(const records &kvs, const int l, const int r, const int ccpl,
     return item;
 }
 
+/**
+ * Collect the model accuracy of the inner nodes in the sub-trie rooted at
+ * item, which is reached after passing depth inner nodes with ccpl common
+ * prefix. HOT children which PMSS decides as model-based nodes are rebuilt
+ * on the side to tell why the model fails on them.
+ *
+ * @return the number of keys in the sub-trie
+ */
+uint64_t collect_model_report(const Item &item, const int depth,
+                              const int ccpl, const HPT *hpt,
+                              const PMSS *pmss, ModelReport &rep) {
+    switch (item.get_itype()) {
+    case ITYP_Sing: {
+        return 1;
+    }
+    case ITYP_CNod: {
+        return item.get_cnode()->h.key_cnt;
+    }
+    case ITYP_Trie: {
+        uint64_t coded_subtrie = item.get_coded_index();
+        auto &hot = ((HOTIndex &)coded_subtrie);
+        uint64_t n = 0;
+        for (auto it = hot.begin(); it != HOTIndex::END_ITERATOR; ++it) {
+            n++;
+        }
+        return n;
+    }
+    case ITYP_Mult: {
+        InnerNode *node = item.get_inner_node();
+        Item *item_array = node->get_items();
+        uint64_t len = node->get_item_array_len();
+        int child_ccpl = ccpl + node->get_prefix_length();
+
+        // Reserve the slot of this node before visiting the children
+        int idx = rep.nodes.size();
+        rep.nodes.push_back(NodeReport());
+        NodeReport nr;
+        nr.depth = depth;
+        nr.slots = len;
+        nr.used_slots = nr.keys = nr.max_keys = 0;
+
+        for (int i = 0; i < len; ++i) {
+            const Item &child = item_array[i];
+            if (child.is_empty())
+                continue;
+            uint64_t n = collect_model_report(child, depth + 1, child_ccpl,
+                                              hpt, pmss, rep);
+            nr.used_slots++;
+            nr.keys += n;
+            nr.max_keys = std::max(nr.max_keys, n);
+
+            switch (child.get_itype()) {
+            case ITYP_Sing:
+                nr.sing_keys += n;
+                break;
+            case ITYP_CNod:
+                nr.cnode_keys += n;
+                break;
+            case ITYP_Mult:
+                nr.inner_keys += n;
+                break;
+            case ITYP_Trie: {
+                nr.hot_keys += n;
+
+                // Was this HOT a FAIL_TO_BULK fallback?
+                uint64_t coded_subtrie = child.get_coded_index();
+                auto &hot = ((HOTIndex &)coded_subtrie);
+                KVS1 kvs;
+                for (auto it = hot.begin(); it != HOTIndex::END_ITERATOR;
+                     ++it) {
+                    kvs.push((*it).getKV());
+                }
+                if (pmss->decideSubType(n, getGPKL(kvs, 0, n)) !=
+                    STYP_Items)
+                    break;
+
+                ModelFail why = MFAIL_None;
+                InnerNode *trial = _try_rebulk_as_model_node(
+                    kvs, 0, n, child_ccpl, hpt, pmss, &why);
+                if (trial) {
+                    // The kv entries stay owned by the HOT
+                    Item tmp;
+                    tmp.set_inner_node(trial);
+                    KVS1 scratch;
+                    tmp.recursive_extract(scratch);
+                    nr.stale_hots++;
+                } else {
+                    nr.fallbacks++;
+                    nr.fallback_keys += n;
+                    nr.fallback_why[why]++;
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        rep.nodes[idx] = nr;
+        return nr.keys;
+    }
+    }
+    return 0;
+}
+
 inline kv *trie_search(const Item &item, const str _key) {
     uint64_t subtrie = item.get_coded_index();
     return HOTLookup((HOTIndex &)subtrie, _key);
@@ -516,7 +1405,7 @@ inline kv *sing_search(const Item &item, const str _key, const int ccpl) {
 }
 
 inline kv *cnod_search(const Item &item, const str _key) {
-    return _cnode_search(item.get_cnode(), _key);
+    return _cnode_search(item.get_cnode(), _key, KeyMeta(_key));
 }
 
 inline bool trie_insert(Item &node, const str ckey, const val cval) {
@@ -551,16 +1440,19 @@ inline bool sing_insert(Item &node, const str ckey, const val cval,
 inline bool cnod_insert(Item &node, const str ckey, const val cval,
                         const HPT *hpt, const PMSS *pmss) {
     Cnode *cnode = node.get_cnode();
-    if (cnode->has_room()) {
-        bool result = _cnode_withRoom_insert(cnode, ckey, cval);
+    KeyMeta meta(ckey);
+    if (cnode->has_room(pmss->cnode_size)) {
+        bool result = _cnode_withRoom_insert(cnode, ckey, cval, meta);
         node.set_cnode(cnode);
         return result;
     } else {
         // Re bulk load the sub-trie
         int ccpl = cnode->h.ccpl;
         KVS1 kvs;
-        if (try_extract_keys_if_valid_insert(cnode, kvs, ckey, cval)) {
-            node = pmss_bulk(kvs, 0, CNODE_SIZE + 1, ccpl, hpt, pmss);
+        if (try_extract_keys_if_valid_insert(cnode, kvs, ckey, cval, meta)) {
+            count(&Counters::cnode_rebulks);
+            LITS_TRACE_EVENT(TEV_CnodeRebulk);
+            node = pmss_bulk(kvs, 0, kvs.getSize(), ccpl, hpt, pmss);
             return true;
         }
 
@@ -570,11 +1462,9 @@ inline bool cnod_insert(Item &node, const str ckey, const val cval,
 
 inline val trie_upsert(Item &node, const str ckey, const val cval) {
     uint64_t coded_subtrie = node.get_coded_index();
-    auto result = HOTUpsert((HOTIndex &)coded_subtrie, ckey, cval);
+    val result = HOTUpsert((HOTIndex &)coded_subtrie, ckey, cval);
     node.set_coded_index((HOTIndex &)coded_subtrie);
-    if (result)
-        return result->read();
-    return 0;
+    return result;
 }
 
 inline val sing_upsert(Item &node, const str ckey, const val cval,
@@ -604,17 +1494,21 @@ inline val sing_upsert(Item &node, const str ckey, const val cval,
 inline val cnod_upsert(Item &node, const str ckey, const val cval,
                        const HPT *hpt, const PMSS *pmss) {
     Cnode *cnode = node.get_cnode();
-    if (cnode->has_room()) {
-        val result = _cnode_withRoom_upsert(cnode, ckey, cval);
+    KeyMeta meta(ckey);
+    if (cnode->has_room(pmss->cnode_size)) {
+        val result = _cnode_withRoom_upsert(cnode, ckey, cval, meta);
         node.set_cnode(cnode);
         return result;
     } else {
         // Re bulk load the sub-trie
         int ccpl = cnode->h.ccpl;
         KVS1 kvs;
-        val res = try_extract_keys_if_valid_upsert(cnode, kvs, ckey, cval);
+        val res =
+            try_extract_keys_if_valid_upsert(cnode, kvs, ckey, cval, meta);
         if (res == 0) {
-            node = pmss_bulk(kvs, 0, CNODE_SIZE + 1, ccpl, hpt, pmss);
+            count(&Counters::cnode_rebulks);
+            LITS_TRACE_EVENT(TEV_CnodeRebulk);
+            node = pmss_bulk(kvs, 0, kvs.getSize(), ccpl, hpt, pmss);
             return 0;
         }
         return res;
@@ -634,21 +1528,29 @@ inline bool sing_remove(Item &node, const str ckey, const int ccpl) {
 
 inline bool trie_remove(Item &node, const str ckey) {
     uint64_t coded_subtrie = node.get_coded_index();
-    bool result = HOTRemove((HOTIndex &)coded_subtrie, ckey);
-    node.set_coded_index((HOTIndex &)coded_subtrie);
+    HOTIndex &hot = (HOTIndex &)coded_subtrie;
+    bool result = HOTRemove(hot, ckey);
+    // An empty HOT is not iterable, so that the slot is emptied instead
+    if (hot.isEmpty()) {
+        hot.~HOTSingleThreaded();
+        node.set_null();
+        return result;
+    }
+    node.set_coded_index(hot);
     return result;
 }
 
 inline bool cnod_remove(Item &node, const str ckey, const HPT *hpt,
                         const PMSS *pmss) {
     Cnode *cnode = node.get_cnode();
+    KeyMeta meta(ckey);
     if (cnode->more_than_2()) {
-        bool result = _cnode_withRoom_remove(cnode, ckey);
+        bool result = _cnode_withRoom_remove(cnode, ckey, meta);
         node.set_cnode(cnode);
         return result;
     } else {
         // (possibly) Degrade the cnode into a single entry
-        kv *entry = _cnode_degrade(cnode, ckey);
+        kv *entry = _cnode_degrade(cnode, ckey, meta);
         if (entry == NULL) {
             return false;
         }
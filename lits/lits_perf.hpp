@@ -0,0 +1,179 @@
+#pragma once
+
+#include "lits_base.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lits {
+
+// The hardware events counted
+enum PerfEvent {
+    PC_Cycles = 0,
+    PC_Instructions,
+    PC_L1DMisses,
+    PC_LLCMisses,
+    PC_DTLBMisses,
+    PC_BranchMisses,
+    PC_Num
+};
+
+/**
+ * A reading (or the difference of two readings) of the counters. Counters
+ * which could not be opened are not valid.
+ */
+class PerfSample {
+  public:
+    double v[PC_Num] = {0};
+    bool valid[PC_Num] = {false};
+
+  public:
+    bool any_valid() const {
+        for (int i = 0; i < PC_Num; ++i)
+            if (valid[i])
+                return true;
+        return false;
+    }
+
+    PerfSample operator-(const PerfSample &o) const {
+        PerfSample d;
+        for (int i = 0; i < PC_Num; ++i) {
+            d.valid[i] = valid[i] && o.valid[i];
+            d.v[i] = d.valid[i] ? v[i] - o.v[i] : 0;
+        }
+        return d;
+    }
+
+    PerfSample &operator+=(const PerfSample &o) {
+        for (int i = 0; i < PC_Num; ++i) {
+            valid[i] = valid[i] || o.valid[i];
+            v[i] += o.v[i];
+        }
+        return *this;
+    }
+
+    /**
+     * Print the counters divided by ops (per operation), and the IPC.
+     */
+    void print(std::ostream &os, const double ops,
+               const char *prefix = "[Perf]: ") const {
+        static const char *names[PC_Num] = {"cycles",     "instructions",
+                                            "L1D-misses", "LLC-misses",
+                                            "dTLB-misses", "branch-misses"};
+        if (!any_valid())
+            return;
+        std::ios::fmtflags flags = os.flags();
+        std::streamsize precision = os.precision();
+        os << std::fixed << std::setprecision(2) << prefix;
+        for (int i = 0; i < PC_Num; ++i) {
+            if (valid[i])
+                os << names[i] << " " << v[i] / ops << ", ";
+        }
+        if (valid[PC_Cycles] && valid[PC_Instructions] && v[PC_Cycles] > 0)
+            os << "IPC " << v[PC_Instructions] / v[PC_Cycles];
+        os << " (per op)" << std::endl;
+        os.flags(flags);
+        os.precision(precision);
+    }
+};
+
+/**
+ * Hardware performance counters of the calling thread (and the threads it
+ * creates afterwards), through perf_event_open.
+ *
+ * Each event is opened on its own, so that an event the CPU or the kernel
+ * does not support only drops that event. If none can be opened (e.g. not
+ * Linux, or perf_event_paranoid forbids it), available() is false and the
+ * readings carry no valid counter, so callers fall back to timing only.
+ * Counts are scaled by the time the event was actually scheduled on the PMU.
+ */
+class PerfCounters {
+  private:
+    int fds[PC_Num];
+
+  public:
+    PerfCounters() {
+        for (int i = 0; i < PC_Num; ++i)
+            fds[i] = -1;
+#ifdef __linux__
+        static const uint32_t types[PC_Num] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+            PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+        static const uint64_t configs[PC_Num] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            cacheMiss(PERF_COUNT_HW_CACHE_L1D),
+            cacheMiss(PERF_COUNT_HW_CACHE_LL),
+            cacheMiss(PERF_COUNT_HW_CACHE_DTLB),
+            PERF_COUNT_HW_BRANCH_MISSES};
+
+        for (int i = 0; i < PC_Num; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.inherit = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int i = 0; i < PC_Num; ++i) {
+            if (fds[i] >= 0)
+                close(fds[i]);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const {
+        for (int i = 0; i < PC_Num; ++i)
+            if (fds[i] >= 0)
+                return true;
+        return false;
+    }
+
+    /**
+     * Read the running totals of the counters.
+     */
+    PerfSample read() const {
+        PerfSample s;
+#ifdef __linux__
+        for (int i = 0; i < PC_Num; ++i) {
+            uint64_t buf[3]; // value, time enabled, time running
+            if (fds[i] < 0 || ::read(fds[i], buf, sizeof(buf)) != sizeof(buf))
+                continue;
+            s.valid[i] = true;
+            s.v[i] = buf[2] ? (double)buf[0] * buf[1] / buf[2] : buf[0];
+        }
+#endif
+        return s;
+    }
+
+  private:
+#ifdef __linux__
+    static constexpr uint64_t cacheMiss(const uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+#endif
+};
+
+}; // namespace lits
@@ -2,6 +2,8 @@
 
 #include "lits_cnode.hpp"
 
+#include <cfloat>
+
 namespace lits {
 
 /**
@@ -13,6 +15,15 @@ const int max_das = 27;
 const int min_pkl = 3;
 const int max_pkl = 20;
 
+/**
+ * Item array scale factor candidates, relative to the policy's one, and the
+ * cost of a slot per key in keys sharing a slot (each a level deeper). With
+ * keys spread uniformly at random, 1 - e^(-1/s) of them share a slot at s
+ * slots per key, so 0.12 puts the least cost at the policy's factor 2
+ */
+const double scale_candidates[] = {0.5, 0.75, 1, 1.5, 2};
+const double slot_cost = 0.12;
+
 const int das_delt = max_das - min_das + 1;
 const int pkl_delt = max_pkl - min_pkl + 1;
 
@@ -1884,8 +1895,21 @@ class PMSS {
     double read_ratio;
     double write_ratio;
 
-    PMSS(double _read_ratio = 1, double _write_ratio = 0)
-        : read_ratio(_read_ratio), write_ratio(_write_ratio) {}
+    // The maximum number of keys in a compact leaf node
+    int cnode_size;
+
+    // The item array slots per key of a model-based node
+    int scale_factor;
+
+    // The most item array slots per key a model-based node may choose, no
+    // choice (always scale_factor) if below 1, as by default
+    double scale_budget;
+
+    PMSS(double _read_ratio = 1, double _write_ratio = 0,
+         int _cnode_size = CNODE_SIZE, int _scale_factor = ScaleFactor)
+        : read_ratio(_read_ratio), write_ratio(_write_ratio),
+          cnode_size(_cnode_size), scale_factor(_scale_factor),
+          scale_budget(0) {}
 
     /**
      * @brief Structural Decision Tree. This function is used to decide the
@@ -1900,7 +1924,7 @@ class PMSS {
      */
     SubTrieType decideSubType(int data_size, double _pkl) const {
         // Cnode is preferred when the data size is small
-        if (data_size <= CNODE_SIZE) {
+        if (data_size <= cnode_size) {
             return STYP_Cnode;
         }
 
@@ -1972,6 +1996,51 @@ class PMSS {
         }
         return STYP_Trie;
     }
+
+    /**
+     * @brief Decide the item array slots per key of a model-based node from
+     * a dry-run distribution of (a sample of) its keys. A key sharing its
+     * slot costs a level more on lookup, a slot costs slot_cost of it, so
+     * the well-modelled nodes shrink and the conflicting ones grow.
+     *
+     * @param xs The model positions k * cdf + b of the sorted sample keys.
+     *
+     * @return the slots per key, within scale_budget.
+     */
+    double decideScaleFactor(const std::vector<double> &xs) const {
+        int n = xs.size();
+        double best = scale_factor, best_cost = DBL_MAX;
+        for (double c : scale_candidates) {
+            double s = c * scale_factor;
+            if (s < 1 || s > scale_budget)
+                continue;
+
+            // The slots are monotone in the sorted keys, as in distribution
+            int64_t len = std::max<int64_t>(n * s, 3);
+            int shared = 0, run = 1, last = -1;
+            for (int i = 0; i < n; ++i) {
+                int pos = std::max<int64_t>(
+                    std::min<int64_t>(xs[i] * (len - 2), len - 3), 0);
+                if (pos == last) {
+                    run++;
+                    continue;
+                }
+                if (run > 1)
+                    shared += run;
+                run = 1;
+                last = pos;
+            }
+            if (run > 1)
+                shared += run;
+
+            double cost = (double)shared / n + slot_cost * s;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = s;
+            }
+        }
+        return best;
+    }
 };
 
 } // namespace lits
\ No newline at end of file
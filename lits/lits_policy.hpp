@@ -0,0 +1,44 @@
+#pragma once
+
+#include "lits_base.hpp"
+#include "lits_model.hpp"
+
+namespace lits {
+
+/**
+ * The structural parameters of an index, fixed at compile time, so that one
+ * process can host indexes tuned for different keys (see BasicLITS).
+ *
+ * The node and model code is not specialized per policy: the HPT sizes its
+ * table by the hash lengths it is built with, and the PMSS carries the cnode
+ * size and scale factor to the bulk load and insert decisions. A lookup only
+ * reads the hash masks, once per node, next to the table pointer.
+ *
+ * @param CnodeSize The maximum number of keys in a compact leaf node.
+ * @param Scale The item array slots per key of a model-based node.
+ * @param PsHashLen The HPT position hash bits length.
+ * @param FcHashLen The HPT front char hash bits length.
+ */
+template <int CnodeSize, int Scale, int PsHashLen, int FcHashLen>
+class LitsPolicy {
+  public:
+    static constexpr int cnode_size = CnodeSize;
+    static constexpr int scale_factor = Scale;
+    static constexpr int ps_hash_len = PsHashLen;
+    static constexpr int fc_hash_len = FcHashLen;
+
+    // A cnode of 2 keys is built by any insert into a single entry
+    static_assert(CnodeSize >= 2 && CnodeSize <= 64, "Invalid cnode size");
+    static_assert(Scale >= 1 && Scale <= 8, "Invalid scale factor");
+
+    // The hash bits index the lines of the HPT
+    static_assert(PsHashLen >= 0 && PsHashLen <= 8, "Invalid PS hash length");
+    static_assert(FcHashLen >= 0 && FcHashLen <= 7, "Invalid FC hash length");
+};
+
+// The parameters LITS was tuned with
+typedef LitsPolicy<CNODE_SIZE, ScaleFactor, HPT::PS_HASH_LEN,
+                   HPT::FC_HASH_LEN>
+    DefaultPolicy;
+
+}; // namespace lits
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "lits.hpp"
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace lits {
+
+/**
+ * A LITS partitioned by key range into shards, each guarded by a
+ * reader-writer lock, so that it can be shared by multiple threads.
+ *
+ * Lookups and scans of different threads run in parallel, writes are
+ * serialized per shard. Since the shards are ranges of the bulk loaded keys,
+ * a scan continues into the next shard when one runs out.
+ */
+class ShardedLITS {
+  private:
+    typedef struct {
+        LITS index;
+        std::string lower; // the smallest key routed to this shard
+        std::shared_timed_mutex lock;
+    } shard;
+
+    std::vector<std::unique_ptr<shard>> shards;
+
+  public:
+    ShardedLITS() = default;
+    ~ShardedLITS() = default;
+
+    /**
+     * Bulk load the sorted and unique keys into (at most) num_shards shards
+     * of equal size. Every shard needs LITS's minimum bulk load size.
+     */
+    bool bulkload(const char **_keys, const uint64_t *_vals, const int _len,
+                  int num_shards) {
+        RT_ASSERT(shards.empty());
+        num_shards = std::max(1, std::min(num_shards, _len / 1000));
+        for (int i = 0; i < num_shards; ++i) {
+            int l = (int64_t)_len * i / num_shards;
+            int r = (int64_t)_len * (i + 1) / num_shards;
+            shards.emplace_back(new shard());
+            shard &s = *shards.back();
+            s.lower = i ? _keys[l] : "";
+            if (!s.index.bulkload(_keys + l, _vals + l, r - l)) {
+                shards.pop_back();
+                destroy();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void destroy() {
+        for (auto &s : shards) {
+            s->index.destroy();
+        }
+        shards.clear();
+    }
+
+    int num_shards() const { return shards.size(); }
+
+    /**
+     * Return the shard the key is routed to.
+     */
+    int shard_of(const char *_key) const {
+        int l = 0, r = shards.size() - 1;
+        while (l < r) {
+            int m = (l + r + 1) / 2;
+            if (ustrcmp((const str)shards[m]->lower.c_str(), (const str)_key) <=
+                0)
+                l = m;
+            else
+                r = m - 1;
+        }
+        return l;
+    }
+
+    /**
+     * Lookup the key, copy the value into _val if found.
+     */
+    bool lookup(const char *_key, uint64_t &_val) {
+        shard &s = *shards[shard_of(_key)];
+        std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+        kv *res = s.index.lookup(_key);
+        if (res == NULL)
+            return false;
+        _val = res->read();
+        return true;
+    }
+
+    bool insert(const char *_key, const uint64_t _val) {
+        shard &s = *shards[shard_of(_key)];
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        return s.index.insert(_key, _val);
+    }
+
+    val upsert(const char *_key, const uint64_t _val) {
+        shard &s = *shards[shard_of(_key)];
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        return s.index.upsert(_key, _val);
+    }
+
+    bool remove(const char *_key) {
+        shard &s = *shards[shard_of(_key)];
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        return s.index.remove(_key);
+    }
+
+    /**
+     * Read-modify-write the value of the key under one lock. f maps the old
+     * value to the new one.
+     */
+    template <class F> bool update(const char *_key, F f) {
+        shard &s = *shards[shard_of(_key)];
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        kv *res = s.index.lookup(_key);
+        if (res == NULL)
+            return false;
+        res->update(f(res->read()));
+        return true;
+    }
+
+    /**
+     * Call f on (at most) cnt kv entries starting from the key, crossing the
+     * shards if needed. Return the number of kv entries visited, 0 if the
+     * key is not in the index (find is exact-match).
+     */
+    template <class F> int scan(const char *_key, const int cnt, F f) {
+        int done = 0;
+        for (int i = shard_of(_key); i < shards.size() && done < cnt; ++i) {
+            shard &s = *shards[i];
+            std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+            litsIter iter = done ? s.index.begin() : s.index.find(_key);
+            // The key is missing, or the shard has been emptied
+            if (!iter.valid()) {
+                if (done == 0)
+                    break;
+                continue;
+            }
+            for (; done < cnt && iter.not_finish(); iter.next()) {
+                f(iter.getKV());
+                done++;
+            }
+        }
+        return done;
+    }
+
+    /**
+     * Return the bytes used by all the shards.
+     */
+    uint64_t memory_usage() const {
+        uint64_t bytes = 0;
+        for (auto &s : shards) {
+            bytes += s->index.memory_usage();
+        }
+        return bytes;
+    }
+};
+
+}; // namespace lits
@@ -0,0 +1,497 @@
+#pragma once
+
+#include "lits_base.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// For the allocation hook of HOT's node pool
+#include "hot_src/MemoryPool.hpp"
+
+namespace lits {
+
+/**
+ * Counters maintained incrementally by the structural code paths.
+ *
+ * LITS binds its own counters to the running thread for the duration of each
+ * operation (see CountersScope), so that free functions such as new_kv,
+ * new_cnode or pmss_bulk can charge them without another parameter being
+ * threaded through every call.
+ */
+class Counters {
+  public:
+    // Live bytes of each component
+    int64_t inner_bytes = 0; // model-based inner nodes
+    int64_t cnode_bytes = 0; // compact leaf nodes
+    int64_t kv_bytes = 0;    // kv entries (header + key)
+    int64_t hot_bytes = 0;   // HOT nodes
+
+    // The parts of the above that are not arrays of items or kv pointers
+    int64_t inner_header_bytes = 0; // inner node headers and prefixes
+    int64_t cnode_header_bytes = 0; // Cnode headers
+    int64_t kv_key_bytes = 0;       // keys, with the null terminator
+
+    // Structural rebuilds
+    uint64_t path_rebuilds = 0; // PathStack::change_num resize rebuilds
+    uint64_t cnode_rebulks = 0; // full Cnode re-bulk loaded by pmss_bulk
+
+    // Inserts resumed from the path of the last insert (see AppendCursor)
+    uint64_t appends = 0;
+
+    // Inserts and upserts resumed from the path of a find hint
+    uint64_t hinted = 0;
+
+    // kv entries freed, which (with model_builds) stales the find hints
+    uint64_t kv_frees = 0;
+
+    // Sub-tries built by pmss_bulk, by type, and the time spent on the GPKL
+    uint64_t model_builds = 0; // model-based inner nodes
+    uint64_t hot_builds = 0;   // HOT sub-tries
+    uint64_t cnode_builds = 0; // compact leaf nodes
+    int64_t gpkl_ns = 0;
+
+    // Whether a bulk load is collecting its phases, so that the GPKL is
+    // timed (and not on the rebuilds of the writes)
+    bool timing_phases = false;
+
+    // Failed attempts to build a model-based inner node, by ModelFail
+    uint64_t fail_flat_cdf = 0;
+    uint64_t fail_indiscernible = 0;
+    uint64_t fail_reversed = 0;
+
+    int64_t total_bytes() const {
+        return inner_bytes + cnode_bytes + kv_bytes + hot_bytes;
+    }
+
+    /**
+     * Take over the live bytes of other, whose structures are moved here.
+     */
+    void take_bytes(Counters &other) {
+        Counters part = other;
+        other.move_bytes(*this, part);
+    }
+
+    /**
+     * Move the live bytes of part, the structures handed over, to other.
+     */
+    void move_bytes(Counters &other, const Counters &part) {
+        int64_t Counters::*fields[] = {
+            &Counters::inner_bytes,        &Counters::cnode_bytes,
+            &Counters::kv_bytes,           &Counters::hot_bytes,
+            &Counters::inner_header_bytes, &Counters::cnode_header_bytes,
+            &Counters::kv_key_bytes};
+        for (int64_t Counters::*f : fields) {
+            this->*f -= part.*f;
+            other.*f += part.*f;
+        }
+    }
+};
+
+/**
+ * Why building a model-based inner node failed (the FAIL_TO_BULK path).
+ */
+typedef enum {
+    MFAIL_None = 0,
+    // The CDFs of the first and the last key are flat or reversed
+    MFAIL_FlatCDF,
+    // The first and the last key are predicted into the same slot
+    MFAIL_Indiscernible,
+    // A key is predicted before its predecessor or out of the item array
+    MFAIL_Reversed,
+    MFAIL_Num
+} ModelFail;
+
+/**
+ * Return the counter of the model failure reason.
+ */
+inline uint64_t Counters::*failCounter(const ModelFail why) {
+    switch (why) {
+    case MFAIL_FlatCDF:
+        return &Counters::fail_flat_cdf;
+    case MFAIL_Indiscernible:
+        return &Counters::fail_indiscernible;
+    default:
+        return &Counters::fail_reversed;
+    }
+}
+
+/**
+ * Return the counters bound to the running thread, NULL if none.
+ */
+inline Counters *&activeCounters() {
+    static thread_local Counters *counters = NULL;
+    return counters;
+}
+
+/**
+ * Charge the bound counters (if any) with a byte delta.
+ */
+inline void charge(int64_t Counters::*field, const int64_t bytes) {
+    Counters *c = activeCounters();
+    if (c)
+        c->*field += bytes;
+}
+
+/**
+ * Count a structural event on the bound counters (if any).
+ */
+inline void count(uint64_t Counters::*field) {
+    Counters *c = activeCounters();
+    if (c)
+        c->*field += 1;
+}
+
+/**
+ * Bind the counters to the running thread until the end of the scope.
+ */
+class CountersScope {
+  private:
+    Counters *prev;
+
+  public:
+    CountersScope(Counters *c) : prev(activeCounters()) {
+        activeCounters() = c;
+    }
+    ~CountersScope() { activeCounters() = prev; }
+};
+
+/**
+ * Route HOT's node pool allocations to the bound counters.
+ */
+inline void chargeHOT(std::ptrdiff_t bytes) {
+    charge(&Counters::hot_bytes, bytes);
+}
+
+static const bool hot_hook_installed =
+    (hot::singlethreaded::memoryPoolHook() = chargeHOT, true);
+
+/**
+ * The bytes of a LITS index, split by what they store.
+ */
+class MemoryBreakdown {
+  public:
+    uint64_t keys = 0;          // key payload (with the null terminators)
+    uint64_t values = 0;        // values
+    uint64_t kv_headers = 0;    // the length and hash of the kv entries
+    uint64_t inner_headers = 0; // inner node headers and prefixes
+    uint64_t item_arrays = 0;   // inner node item arrays
+    uint64_t cnode_headers = 0; // Cnode headers
+    uint64_t cnode_arrays = 0;  // Cnode kv pointer arrays
+    uint64_t hot = 0;           // HOT nodes
+    uint64_t model = 0;         // the HPT
+
+  public:
+    MemoryBreakdown() = default;
+
+    MemoryBreakdown(const Counters &c, const uint64_t model_bytes) {
+        // Besides the key, a kv entry holds its value and an 8-byte header
+        uint64_t entries =
+            (c.kv_bytes - c.kv_key_bytes) / (2 * sizeof(uint64_t));
+        keys = c.kv_key_bytes;
+        values = entries * sizeof(uint64_t);
+        kv_headers = c.kv_bytes - c.kv_key_bytes - values;
+        inner_headers = c.inner_header_bytes;
+        item_arrays = c.inner_bytes - c.inner_header_bytes;
+        cnode_headers = c.cnode_header_bytes;
+        cnode_arrays = c.cnode_bytes - c.cnode_header_bytes;
+        hot = c.hot_bytes;
+        model = model_bytes;
+    }
+
+    uint64_t total() const {
+        return keys + values + kv_headers + inner_headers + item_arrays +
+               cnode_headers + cnode_arrays + hot + model;
+    }
+
+    /**
+     * Print the bytes per key of every part.
+     */
+    void print(const uint64_t num_keys, std::ostream &os = std::cout) const {
+        const char *names[] = {"keys",          "values",       "kv headers",
+                               "inner headers", "item arrays",  "cnode headers",
+                               "cnode arrays",  "hot",          "model"};
+        const uint64_t bytes[] = {keys,          values,      kv_headers,
+                                  inner_headers, item_arrays, cnode_headers,
+                                  cnode_arrays,  hot,         model};
+        std::ios::fmtflags flags = os.flags();
+        std::streamsize precision = os.precision();
+        os << std::fixed << std::setprecision(2);
+        os << "[Memory]: Total:\t" << total() << " bytes, "
+           << (double)total() / num_keys << " bytes/key" << std::endl;
+        os << "[Memory]: Per Key:\t";
+        for (int i = 0; i < 9; ++i) {
+            os << (i ? ", " : "") << names[i] << " "
+               << (double)bytes[i] / num_keys;
+        }
+        os << std::endl;
+        os.flags(flags);
+        os.precision(precision);
+    }
+};
+
+/**
+ * The hit rate and the memory of a LookupCache (see lits_cache.hpp).
+ */
+class CacheStats {
+  public:
+    uint64_t lookups = 0;       // lookups probing the cache
+    uint64_t hits = 0;          // lookups answered by the cache
+    uint64_t admissions = 0;    // kv entries admitted
+    uint64_t rejections = 0;    // kv entries rejected by the admission
+    uint64_t invalidations = 0; // entries dropped since their kv was freed
+    uint64_t bytes = 0;         // the memory of the cache
+
+    double hit_rate() const { return lookups ? (double)hits / lookups : 0; }
+
+    void print(std::ostream &os = std::cout) const {
+        os << "[Cache]: Hit Rate:\t" << 100 * hit_rate() << "% of " << lookups
+           << " lookups" << std::endl;
+        os << "[Cache]: Entries:\tadmitted " << admissions << ", rejected "
+           << rejections << ", invalidated " << invalidations << std::endl;
+        os << "[Cache]: Memory:\t" << bytes << " bytes" << std::endl;
+    }
+};
+
+/**
+ * Structural statistics of a LITS index, computed by one traversal.
+ */
+class Stats {
+  public:
+    // Per-level conflict information of model-based inner nodes
+    typedef struct {
+        uint64_t nodes;      // inner nodes on this level
+        uint64_t slots;      // item array slots
+        uint64_t used_slots; // non-empty slots
+        uint64_t keys;       // keys under this level
+    } level;
+
+  public:
+    // Item type counts
+    uint64_t num_sing = 0;
+    uint64_t num_cnod = 0;
+    uint64_t num_mult = 0;
+    uint64_t num_trie = 0;
+
+    // Number of keys
+    uint64_t num_keys = 0;
+
+    // depth_hist[d] = keys reached after passing d inner nodes
+    std::vector<uint64_t> depth_hist;
+
+    // levels[d] = inner nodes at depth d
+    std::vector<level> levels;
+
+    // Bytes of each component
+    uint64_t inner_bytes = 0;
+    uint64_t cnode_bytes = 0;
+    uint64_t kv_bytes = 0;
+    uint64_t hot_bytes = 0;
+    uint64_t model_bytes = 0;
+
+    // Rebuild counters
+    uint64_t path_rebuilds = 0;
+    uint64_t cnode_rebulks = 0;
+
+    // Inserts resumed from the path of the last insert
+    uint64_t appends = 0;
+
+    // Inserts and upserts resumed from the path of a find hint
+    uint64_t hinted = 0;
+
+    // Failed model-based node builds, indexed by ModelFail
+    uint64_t model_fails[MFAIL_Num] = {0};
+
+    // The lookup cache, all 0 if none
+    CacheStats cache;
+
+  public:
+    /**
+     * Record n keys reached at depth d.
+     */
+    inline void add_keys(const int d, const uint64_t n) {
+        if ((int)depth_hist.size() <= d)
+            depth_hist.resize(d + 1, 0);
+        depth_hist[d] += n;
+        num_keys += n;
+    }
+
+    /**
+     * Return the level information of depth d.
+     */
+    inline level &get_level(const int d) {
+        if ((int)levels.size() <= d)
+            levels.resize(d + 1, {0, 0, 0, 0});
+        return levels[d];
+    }
+
+    /**
+     * Return the fraction of non-empty item array slots.
+     */
+    double fill_ratio() const {
+        uint64_t slots = 0, used = 0;
+        for (const level &l : levels) {
+            slots += l.slots;
+            used += l.used_slots;
+        }
+        return slots ? (double)used / slots : 0;
+    }
+
+    /**
+     * Return the keys per non-empty slot of level d.
+     */
+    double conflict_degree(const int d) const {
+        const level &l = levels[d];
+        return l.used_slots ? (double)l.keys / l.used_slots : 0;
+    }
+
+    uint64_t total_bytes() const {
+        return inner_bytes + cnode_bytes + kv_bytes + hot_bytes + model_bytes;
+    }
+
+    void print(std::ostream &os = std::cout) const {
+        os << "[Stats]: Keys:\t" << num_keys << std::endl;
+        os << "[Stats]: Items:\tSing " << num_sing << ", CNod " << num_cnod
+           << ", Mult " << num_mult << ", Trie " << num_trie << std::endl;
+        os << "[Stats]: Fill Ratio:\t" << fill_ratio() << std::endl;
+        os << "[Stats]: Bytes:\tinner " << inner_bytes << ", cnode "
+           << cnode_bytes << ", kv " << kv_bytes << ", hot " << hot_bytes
+           << ", model " << model_bytes << std::endl;
+        os << "[Stats]: Rebuilds:\tpath " << path_rebuilds << ", cnode "
+           << cnode_rebulks << std::endl;
+        if (appends)
+            os << "[Stats]: Appends:\t" << appends << std::endl;
+        if (hinted)
+            os << "[Stats]: Hinted:\t" << hinted << std::endl;
+        os << "[Stats]: Model Fails:\tflat cdf " << model_fails[MFAIL_FlatCDF]
+           << ", indiscernible " << model_fails[MFAIL_Indiscernible]
+           << ", reversed " << model_fails[MFAIL_Reversed] << std::endl;
+        if (cache.bytes)
+            cache.print(os);
+        for (int d = 0; d < (int)depth_hist.size(); ++d) {
+            os << "[Stats]: Depth " << d << ":\t" << depth_hist[d] << " keys";
+            if (d < (int)levels.size() && levels[d].nodes) {
+                os << ", " << levels[d].nodes << " nodes, "
+                   << conflict_degree(d) << " keys/slot";
+            }
+            os << std::endl;
+        }
+    }
+};
+
+/**
+ * Model accuracy of one model-based inner node.
+ */
+class NodeReport {
+  public:
+    int depth;
+    uint64_t slots;      // item array slots
+    uint64_t used_slots; // non-empty slots
+    uint64_t keys;       // keys under the node
+    uint64_t max_keys;   // max keys under one slot
+
+    // Keys under each kind of child
+    uint64_t sing_keys = 0;
+    uint64_t cnode_keys = 0;
+    uint64_t hot_keys = 0;
+    uint64_t inner_keys = 0;
+
+    // HOT children which PMSS decides as model-based nodes but the model
+    // fails to build, i.e. the FAIL_TO_BULK fallbacks, and why
+    uint64_t fallbacks = 0;
+    uint64_t fallback_keys = 0;
+    uint64_t fallback_why[MFAIL_Num] = {0};
+
+    // HOT children which PMSS decides as model-based nodes and the model
+    // builds now, e.g. a promoted Cnode that PMSS saw differently
+    uint64_t stale_hots = 0;
+
+  public:
+    double avg_keys() const {
+        return used_slots ? (double)keys / used_slots : 0;
+    }
+
+    /**
+     * Return how well the model spreads the keys, 1 if every key (up to the
+     * number of slots) gets a slot of its own.
+     */
+    double spread() const {
+        uint64_t best = std::min(keys, slots);
+        return best ? (double)used_slots / best : 0;
+    }
+};
+
+/**
+ * Model accuracy of all the model-based inner nodes, in pre-order.
+ */
+class ModelReport {
+  public:
+    std::vector<NodeReport> nodes;
+    uint64_t num_keys = 0;
+
+  public:
+    /**
+     * Return the model quality score in [0, 1]: the key-weighted spread of
+     * the inner nodes, discounted by the fraction of keys in FAIL_TO_BULK
+     * fallbacks.
+     */
+    double quality() const {
+        double weighted = 0, weights = 0;
+        uint64_t fallback_keys = 0;
+        for (const NodeReport &n : nodes) {
+            weighted += n.spread() * n.keys;
+            weights += n.keys;
+            fallback_keys += n.fallback_keys;
+        }
+        if (weights == 0 || num_keys == 0)
+            return 0;
+        return weighted / weights * (1 - (double)fallback_keys / num_keys);
+    }
+
+    /**
+     * Print the summary, and the limit inner nodes holding the most keys.
+     */
+    void print(std::ostream &os = std::cout, const int limit = 10) const {
+        uint64_t sing = 0, cnode = 0, hot = 0, fb = 0, stale = 0;
+        uint64_t why[MFAIL_Num] = {0};
+        for (const NodeReport &n : nodes) {
+            sing += n.sing_keys;
+            cnode += n.cnode_keys;
+            hot += n.hot_keys;
+            fb += n.fallbacks;
+            stale += n.stale_hots;
+            for (int i = 0; i < MFAIL_Num; ++i)
+                why[i] += n.fallback_why[i];
+        }
+        double keys = num_keys ? num_keys : 1;
+
+        os << "[Model]: Inner Nodes:\t" << nodes.size() << std::endl;
+        os << "[Model]: Leaf Keys:\tSing " << sing / keys << ", CNod "
+           << cnode / keys << ", Trie " << hot / keys << std::endl;
+        os << "[Model]: Fallbacks:\t" << fb << " (flat cdf "
+           << why[MFAIL_FlatCDF] << ", indiscernible "
+           << why[MFAIL_Indiscernible] << ", reversed " << why[MFAIL_Reversed]
+           << "), " << stale << " stale HOT" << std::endl;
+        os << "[Model]: Quality:\t" << quality() << std::endl;
+
+        std::vector<const NodeReport *> top;
+        for (const NodeReport &n : nodes)
+            top.push_back(&n);
+        std::sort(top.begin(), top.end(),
+                  [](const NodeReport *a, const NodeReport *b) {
+                      return a->keys > b->keys;
+                  });
+        for (int i = 0; i < (int)top.size() && i < limit; ++i) {
+            const NodeReport &n = *top[i];
+            os << "[Model]: Node (depth " << n.depth << "):\t" << n.keys
+               << " keys, " << n.used_slots << "/" << n.slots
+               << " slots, keys/slot avg " << n.avg_keys() << " max "
+               << n.max_keys << ", HOT " << (double)n.hot_keys / n.keys
+               << ", CNod " << (double)n.cnode_keys / n.keys << ", fallbacks "
+               << n.fallbacks << std::endl;
+        }
+    }
+};
+
+}; // namespace lits
@@ -0,0 +1,401 @@
+#pragma once
+
+#include "lits_base.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LITS_STR_X86 1
+#endif
+
+namespace lits {
+
+/**
+ * String primitives used on every hot path of LITS.
+ *
+ * Each primitive comes in four tiers:
+ *   - Scalar: the byte-at-a-time reference implementation;
+ *   - Word:   8 bytes per step with the classic has-zero-byte trick;
+ *   - SSE42:  16 bytes per step with PCMPISTRI;
+ *   - AVX2:   32 bytes per step with VPCMPEQB / VPMOVMSKB.
+ *
+ * All tiers have exactly the same semantics as the scalar one, including the
+ * signed `char` ordering used by `ustrcmp`. Wide loads never cross a page
+ * boundary which the scalar version would not have touched: a step is only
+ * taken when both source pointers stay inside their current 4KB page, and the
+ * remaining bytes before the boundary are handled one at a time.
+ *
+ * The tier is chosen once at start-up from CPUID. Define LITS_STR_ISA to one
+ * of the StrISA values to pin a tier at compile time.
+ */
+typedef enum : uint8_t {
+    STR_Scalar = 0,
+    STR_Word = 1,
+    STR_SSE42 = 2,
+    STR_AVX2 = 3,
+} StrISA;
+
+// The page size assumed by the page-boundary check
+#define STR_PAGE_SIZE 4096
+
+// Wide loads may read past the terminator inside the same page, which is safe
+// but reported by AddressSanitizer and ThreadSanitizer, so the wide tiers opt
+// out of both.
+#define STR_WIDE_LOAD                                                          \
+    __attribute__((no_sanitize_address, no_sanitize_thread))
+
+/**
+ * Return true if a w-byte load from p would touch the next page.
+ */
+inline bool str_cross_page(const void *p, const int w) {
+    return (((uintptr_t)p) & (STR_PAGE_SIZE - 1)) > STR_PAGE_SIZE - w;
+}
+
+/**
+ * Return the ordering of two characters, same as the scalar comparison.
+ */
+inline int str_order(const char c1, const char c2) {
+    if (c1 == c2)
+        return 0;
+    return c1 > c2 ? 1 : -1;
+}
+
+// ************************************************************
+//                      Scalar Tier
+// ************************************************************
+
+inline int str_scalar_len(const char *s) {
+    int i = 0;
+    for (; s[i]; ++i)
+        ;
+    return i;
+}
+
+inline int str_scalar_cpl(const char *s1, const char *s2) {
+    int i = 0;
+    for (; s1[i] && s2[i] && s1[i] == s2[i]; ++i)
+        ;
+    return i;
+}
+
+inline int str_scalar_cmp(const char *s1, const char *s2) {
+    int i = str_scalar_cpl(s1, s2);
+    return str_order(s1[i], s2[i]);
+}
+
+inline int str_scalar_ncmp(const char *s1, const char *s2, const int len) {
+    for (int i = 0; i < len; ++i) {
+        if (s1[i] != s2[i]) {
+            return s1[i] > s2[i] ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+// ************************************************************
+//                      Word Tier (8B)
+// ************************************************************
+
+/**
+ * Load 8 bytes without alignment requirements. The wide tiers read past the
+ * terminator through it, so it opts out of the sanitizers too: they do not
+ * inline it into callers built without them.
+ */
+STR_WIDE_LOAD inline uint64_t str_load64(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Flag the zero bytes of v. The lowest flagged byte is exactly the first zero
+ * byte (little endian); bytes above it may be false positives.
+ */
+inline uint64_t str_zero_bytes(const uint64_t v) {
+    return (v - 0x0101010101010101UL) & ~v & 0x8080808080808080UL;
+}
+
+STR_WIDE_LOAD inline int str_word_len(const char *s) {
+    int i = 0;
+    while (1) {
+        if (unlikely(str_cross_page(s + i, 8))) {
+            if (!s[i])
+                return i;
+            ++i;
+            continue;
+        }
+        uint64_t z = str_zero_bytes(str_load64(s + i));
+        if (z)
+            return i + (__builtin_ctzll(z) >> 3);
+        i += 8;
+    }
+}
+
+STR_WIDE_LOAD inline int str_word_cpl(const char *s1, const char *s2) {
+    int i = 0;
+    while (1) {
+        if (unlikely(str_cross_page(s1 + i, 8) || str_cross_page(s2 + i, 8))) {
+            if (!s1[i] || s1[i] != s2[i])
+                return i;
+            ++i;
+            continue;
+        }
+        uint64_t a = str_load64(s1 + i);
+        uint64_t m = (a ^ str_load64(s2 + i)) | str_zero_bytes(a);
+        if (m)
+            return i + (__builtin_ctzll(m) >> 3);
+        i += 8;
+    }
+}
+
+STR_WIDE_LOAD inline int str_word_cmp(const char *s1, const char *s2) {
+    int i = str_word_cpl(s1, s2);
+    return str_order(s1[i], s2[i]);
+}
+
+STR_WIDE_LOAD inline int str_word_ncmp(const char *s1, const char *s2,
+                                      const int len) {
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        if (unlikely(str_cross_page(s1 + i, 8) || str_cross_page(s2 + i, 8)))
+            break;
+        uint64_t m = str_load64(s1 + i) ^ str_load64(s2 + i);
+        if (m) {
+            i += __builtin_ctzll(m) >> 3;
+            return str_order(s1[i], s2[i]);
+        }
+    }
+    return str_scalar_ncmp(s1 + i, s2 + i, len - i);
+}
+
+// ************************************************************
+//                      SSE4.2 Tier (16B)
+// ************************************************************
+
+#ifdef LITS_STR_X86
+
+// First NUL byte of the first operand (when both operands are the same)
+#define STR_SSE42_LEN_MODE                                                     \
+    (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_MASKED_NEGATIVE_POLARITY)
+
+// First byte that differs, or where exactly one of the operands has ended
+#define STR_SSE42_CPL_MODE                                                     \
+    (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY)
+
+STR_WIDE_LOAD __attribute__((target("sse4.2"))) inline int
+str_sse42_len(const char *s) {
+    int i = 0;
+    while (1) {
+        if (unlikely(str_cross_page(s + i, 16))) {
+            if (!s[i])
+                return i;
+            ++i;
+            continue;
+        }
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        int idx = _mm_cmpistri(v, v, STR_SSE42_LEN_MODE);
+        if (idx < 16)
+            return i + idx;
+        i += 16;
+    }
+}
+
+STR_WIDE_LOAD __attribute__((target("sse4.2"))) inline int
+str_sse42_cpl(const char *s1, const char *s2) {
+    int i = 0;
+    while (1) {
+        if (unlikely(str_cross_page(s1 + i, 16) ||
+                     str_cross_page(s2 + i, 16))) {
+            if (!s1[i] || s1[i] != s2[i])
+                return i;
+            ++i;
+            continue;
+        }
+        __m128i a = _mm_loadu_si128((const __m128i *)(s1 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s2 + i));
+        int idx = _mm_cmpistri(a, b, STR_SSE42_CPL_MODE);
+        if (idx < 16)
+            return i + idx;
+        // Both strings end at the same position inside this chunk
+        if (_mm_cmpistrs(a, b, STR_SSE42_CPL_MODE))
+            return i + _mm_cmpistri(a, a, STR_SSE42_LEN_MODE);
+        i += 16;
+    }
+}
+
+STR_WIDE_LOAD __attribute__((target("sse4.2"))) inline int
+str_sse42_cmp(const char *s1, const char *s2) {
+    int i = str_sse42_cpl(s1, s2);
+    return str_order(s1[i], s2[i]);
+}
+
+STR_WIDE_LOAD __attribute__((target("sse4.2"))) inline int
+str_sse42_ncmp(const char *s1, const char *s2, const int len) {
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        if (unlikely(str_cross_page(s1 + i, 16) ||
+                     str_cross_page(s2 + i, 16)))
+            break;
+        __m128i a = _mm_loadu_si128((const __m128i *)(s1 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s2 + i));
+        uint32_t m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xffff;
+        if (m) {
+            i += __builtin_ctz(m);
+            return str_order(s1[i], s2[i]);
+        }
+    }
+    return str_word_ncmp(s1 + i, s2 + i, len - i);
+}
+
+// ************************************************************
+//                      AVX2 Tier (32B)
+// ************************************************************
+
+STR_WIDE_LOAD __attribute__((target("avx2"))) inline int
+str_avx2_len(const char *s) {
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    while (1) {
+        if (unlikely(str_cross_page(s + i, 32))) {
+            if (!s[i])
+                return i;
+            ++i;
+            continue;
+        }
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        uint32_t z = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        if (z)
+            return i + __builtin_ctz(z);
+        i += 32;
+    }
+}
+
+STR_WIDE_LOAD __attribute__((target("avx2"))) inline int
+str_avx2_cpl(const char *s1, const char *s2) {
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    while (1) {
+        if (unlikely(str_cross_page(s1 + i, 32) ||
+                     str_cross_page(s2 + i, 32))) {
+            if (!s1[i] || s1[i] != s2[i])
+                return i;
+            ++i;
+            continue;
+        }
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s2 + i));
+        uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) |
+                     (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero));
+        if (m)
+            return i + __builtin_ctz(m);
+        i += 32;
+    }
+}
+
+STR_WIDE_LOAD __attribute__((target("avx2"))) inline int
+str_avx2_cmp(const char *s1, const char *s2) {
+    int i = str_avx2_cpl(s1, s2);
+    return str_order(s1[i], s2[i]);
+}
+
+STR_WIDE_LOAD __attribute__((target("avx2"))) inline int
+str_avx2_ncmp(const char *s1, const char *s2, const int len) {
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        if (unlikely(str_cross_page(s1 + i, 32) ||
+                     str_cross_page(s2 + i, 32)))
+            break;
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s2 + i));
+        uint32_t m =
+            ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        if (m) {
+            i += __builtin_ctz(m);
+            return str_order(s1[i], s2[i]);
+        }
+    }
+    return str_word_ncmp(s1 + i, s2 + i, len - i);
+}
+
+#endif // LITS_STR_X86
+
+// ************************************************************
+//                      Runtime Dispatch
+// ************************************************************
+
+/**
+ * Detect the widest tier supported by the running CPU.
+ */
+inline StrISA detectStrISA() {
+#if defined(LITS_STR_ISA)
+    return (StrISA)(LITS_STR_ISA);
+#elif defined(LITS_STR_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return STR_AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return STR_SSE42;
+    return STR_Word;
+#else
+    return STR_Word;
+#endif
+}
+
+// The tier used by ustrlen / ucpl / ustrcmp
+static const StrISA str_isa = detectStrISA();
+
+inline int str_len(const char *s) {
+    // glibc's strlen is already vectorised and dispatched, and it is faster
+    // than the wide tiers above once keys exceed 32 bytes (see strbench).
+    if (str_isa == STR_Scalar)
+        return str_scalar_len(s);
+    return strlen(s);
+}
+
+inline int str_cpl(const char *s1, const char *s2) {
+    switch (str_isa) {
+#ifdef LITS_STR_X86
+    case STR_AVX2:
+        return str_avx2_cpl(s1, s2);
+    case STR_SSE42:
+        return str_sse42_cpl(s1, s2);
+#endif
+    case STR_Word:
+        return str_word_cpl(s1, s2);
+    default:
+        return str_scalar_cpl(s1, s2);
+    }
+}
+
+inline int str_cmp(const char *s1, const char *s2) {
+    switch (str_isa) {
+#ifdef LITS_STR_X86
+    case STR_AVX2:
+        return str_avx2_cmp(s1, s2);
+    case STR_SSE42:
+        return str_sse42_cmp(s1, s2);
+#endif
+    case STR_Word:
+        return str_word_cmp(s1, s2);
+    default:
+        return str_scalar_cmp(s1, s2);
+    }
+}
+
+inline int str_ncmp(const char *s1, const char *s2, const int len) {
+    switch (str_isa) {
+#ifdef LITS_STR_X86
+    case STR_AVX2:
+        return str_avx2_ncmp(s1, s2, len);
+    case STR_SSE42:
+        return str_sse42_ncmp(s1, s2, len);
+#endif
+    case STR_Word:
+        return str_word_ncmp(s1, s2, len);
+    default:
+        return str_scalar_ncmp(s1, s2, len);
+    }
+}
+
+}; // namespace lits
@@ -0,0 +1,427 @@
+#pragma once
+
+#include "lits_base.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Opt-in tracing of the hot paths.
+ *
+ * Compile with -DLITS_TRACE to record the latency, the depth, the terminal
+ * item type and the structural events of every operation. Without the macro,
+ * all the hooks below expand to nothing.
+ */
+#ifdef LITS_TRACE
+#define LITS_TRACE_SCOPE(op) lits::TraceScope _lits_trace_scope(op)
+#define LITS_TRACE_VISIT(itype) lits::traceVisit(itype)
+#define LITS_TRACE_EVENT(ev) lits::traceEvent(ev)
+#else
+#define LITS_TRACE_SCOPE(op) ((void)0)
+#define LITS_TRACE_VISIT(itype) ((void)0)
+#define LITS_TRACE_EVENT(ev) ((void)0)
+#endif
+
+namespace lits {
+
+// Traced operations
+enum TraceOp {
+    TOP_Lookup = 0,
+    TOP_Insert,
+    TOP_Upsert,
+    TOP_Remove,
+    TOP_Scan, // find plus the following iterations
+    TOP_Num
+};
+
+// Traced structural events
+enum TraceEvent {
+    TEV_PathRebuild = 0b01, // PathStack::change_num resize rebuild
+    TEV_CnodeRebulk = 0b10, // cnod_insert/cnod_upsert re-bulk
+};
+
+// Max depth recorded separately, deeper operations share the last bucket
+#define TRACE_MAX_DEPTH 32
+
+// Item types, indexed by the 3-bit item type
+#define TRACE_ITYP_NUM 8
+
+/**
+ * Read the time stamp counter.
+ */
+inline uint64_t rdtsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/**
+ * Return the time stamp counter ticks per nanosecond, calibrated once
+ * against the steady clock.
+ */
+inline double ticksPerNs() {
+    static const double ratio = [] {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = rdtsc();
+        while (std::chrono::steady_clock::now() - t0 <
+               std::chrono::milliseconds(10))
+            ;
+        auto t1 = std::chrono::steady_clock::now();
+        uint64_t c1 = rdtsc();
+        double ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                .count();
+        return (c1 - c0) / ns;
+    }();
+    return ratio;
+}
+
+/**
+ * Log-linear histogram of 64-bit values.
+ *
+ * Values below 2 * SUB are counted exactly, larger values fall into SUB
+ * linear buckets per power of two, so the relative error is below 1 / SUB.
+ */
+class Histogram {
+  public:
+    static constexpr int SUB_BITS = 5;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+  private:
+    uint64_t buckets[BUCKETS];
+    uint64_t cnt;
+    uint64_t sum;
+    uint64_t max;
+
+  public:
+    Histogram() { reset(); }
+
+    void reset() {
+        memset(buckets, 0, sizeof(buckets));
+        cnt = sum = max = 0;
+    }
+
+    static inline int bucket_of(const uint64_t v) {
+        if (v < 2 * SUB)
+            return v;
+        int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+        return (shift + 1) * SUB + (int)((v >> shift) - SUB);
+    }
+
+    /**
+     * Return the smallest value of a bucket.
+     */
+    static inline uint64_t lower_of(const int b) {
+        if (b < 2 * SUB)
+            return b;
+        int shift = b / SUB - 1;
+        return (uint64_t)(SUB + b % SUB) << shift;
+    }
+
+    /**
+     * Return the largest value of a bucket.
+     */
+    static inline uint64_t upper_of(const int b) {
+        if (b < 2 * SUB)
+            return b;
+        int shift = b / SUB - 1;
+        return lower_of(b) + ((1UL << shift) - 1);
+    }
+
+    inline void record(const uint64_t v) {
+        buckets[bucket_of(v)]++;
+        cnt++;
+        sum += v;
+        if (v > max)
+            max = v;
+    }
+
+    void merge(const Histogram &o) {
+        for (int i = 0; i < BUCKETS; ++i)
+            buckets[i] += o.buckets[i];
+        cnt += o.cnt;
+        sum += o.sum;
+        if (o.max > max)
+            max = o.max;
+    }
+
+    uint64_t count() const { return cnt; }
+
+    double mean() const { return cnt ? (double)sum / cnt : 0; }
+
+    uint64_t maximum() const { return max; }
+
+    /**
+     * Return the value at quantile q (0 < q <= 1), as the largest value of
+     * the bucket holding it.
+     */
+    uint64_t percentile(const double q) const {
+        if (cnt == 0)
+            return 0;
+        uint64_t rank = (uint64_t)std::ceil(q * cnt), seen = 0;
+        if (rank == 0)
+            rank = 1;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(upper_of(i), max);
+        }
+        return max;
+    }
+};
+
+/**
+ * The trace of one kind of operation.
+ */
+class OpTrace {
+  public:
+    Histogram latency;         // ticks of every operation
+    Histogram rebuild_latency; // ticks of the ones that fired an event
+    uint64_t depth[TRACE_MAX_DEPTH];
+    uint64_t itype[TRACE_ITYP_NUM];
+    uint64_t path_rebuilds;
+    uint64_t cnode_rebulks;
+
+  public:
+    OpTrace() { reset(); }
+
+    void reset() {
+        latency.reset();
+        rebuild_latency.reset();
+        memset(depth, 0, sizeof(depth));
+        memset(itype, 0, sizeof(itype));
+        path_rebuilds = cnode_rebulks = 0;
+    }
+
+    void merge(const OpTrace &o) {
+        latency.merge(o.latency);
+        rebuild_latency.merge(o.rebuild_latency);
+        for (int i = 0; i < TRACE_MAX_DEPTH; ++i)
+            depth[i] += o.depth[i];
+        for (int i = 0; i < TRACE_ITYP_NUM; ++i)
+            itype[i] += o.itype[i];
+        path_rebuilds += o.path_rebuilds;
+        cnode_rebulks += o.cnode_rebulks;
+    }
+};
+
+/**
+ * The traces of all kinds of operations.
+ */
+class Trace {
+  public:
+    OpTrace ops[TOP_Num];
+
+  public:
+    void reset() {
+        for (int i = 0; i < TOP_Num; ++i)
+            ops[i].reset();
+    }
+
+    void merge(const Trace &o) {
+        for (int i = 0; i < TOP_Num; ++i)
+            ops[i].merge(o.ops[i]);
+    }
+
+    void print(std::ostream &os = std::cout) const {
+        static const char *op_names[TOP_Num] = {"lookup", "insert", "upsert",
+                                                "remove", "scan"};
+        static const char *ityp_names[TRACE_ITYP_NUM] = {
+            "Null", "Sing", "Mult", "Trie", "CNod", "", "", ""};
+        double tpn = ticksPerNs();
+        std::ios::fmtflags flags = os.flags();
+        std::streamsize precision = os.precision();
+        os << std::fixed << std::setprecision(1);
+
+        for (int i = 0; i < TOP_Num; ++i) {
+            const OpTrace &t = ops[i];
+            if (t.latency.count() == 0)
+                continue;
+            os << "[Trace]: " << op_names[i] << ":\t" << t.latency.count()
+               << " ops, mean " << t.latency.mean() / tpn << " ns";
+            os << ", p50 " << t.latency.percentile(0.5) / tpn;
+            os << ", p99 " << t.latency.percentile(0.99) / tpn;
+            os << ", p99.9 " << t.latency.percentile(0.999) / tpn;
+            os << ", p99.99 " << t.latency.percentile(0.9999) / tpn;
+            os << ", max " << t.latency.maximum() / tpn << " ns" << std::endl;
+
+            os << "[Trace]: " << op_names[i] << " depth:\t";
+            for (int d = 0; d < TRACE_MAX_DEPTH; ++d) {
+                if (t.depth[d])
+                    os << d << ":" << t.depth[d] << " ";
+            }
+            os << std::endl;
+
+            os << "[Trace]: " << op_names[i] << " terminal:\t";
+            for (int k = 0; k < TRACE_ITYP_NUM; ++k) {
+                if (t.itype[k])
+                    os << ityp_names[k] << ":" << t.itype[k] << " ";
+            }
+            os << std::endl;
+
+            if (t.rebuild_latency.count()) {
+                os << "[Trace]: " << op_names[i] << " rebuilds:\tpath "
+                   << t.path_rebuilds << ", cnode " << t.cnode_rebulks
+                   << ", p50 " << t.rebuild_latency.percentile(0.5) / tpn
+                   << " ns, max " << t.rebuild_latency.maximum() / tpn
+                   << " ns" << std::endl;
+            }
+        }
+
+        os.flags(flags);
+        os.precision(precision);
+    }
+};
+
+/**
+ * Registry of the per-thread traces.
+ *
+ * Every thread records into its own Trace without synchronization. The
+ * registry merges the traces of live threads on demand, and keeps the traces
+ * of exited threads in retired.
+ */
+class TraceRegistry {
+  public:
+    std::mutex mtx;
+    std::vector<Trace *> live;
+    Trace retired;
+
+    static TraceRegistry &get() {
+        static TraceRegistry *registry = new TraceRegistry();
+        return *registry;
+    }
+};
+
+/**
+ * The trace of the running thread, registered on first use.
+ */
+class ThreadTrace {
+  public:
+    Trace trace;
+
+    // The operation in progress
+    int op = -1;
+    uint64_t start;
+    int visits;
+    int itype;
+    int events;
+
+  public:
+    ThreadTrace() {
+        TraceRegistry &r = TraceRegistry::get();
+        std::lock_guard<std::mutex> lock(r.mtx);
+        r.live.push_back(&trace);
+    }
+
+    ~ThreadTrace() {
+        TraceRegistry &r = TraceRegistry::get();
+        std::lock_guard<std::mutex> lock(r.mtx);
+        r.retired.merge(trace);
+        for (int i = 0; i < (int)r.live.size(); ++i) {
+            if (r.live[i] == &trace) {
+                r.live.erase(r.live.begin() + i);
+                break;
+            }
+        }
+    }
+};
+
+inline ThreadTrace &threadTrace() {
+    static thread_local ThreadTrace t;
+    return t;
+}
+
+/**
+ * Trace one operation until the end of the scope. Nested scopes (e.g. the
+ * find inside a traced scan) are merged into the outermost one.
+ */
+class TraceScope {
+  private:
+    ThreadTrace &t;
+    bool owner;
+
+  public:
+    TraceScope(const TraceOp op) : t(threadTrace()), owner(t.op < 0) {
+        if (owner) {
+            t.op = op;
+            t.visits = 0;
+            t.itype = 0;
+            t.events = 0;
+            t.start = rdtsc();
+        }
+    }
+
+    ~TraceScope() {
+        if (!owner)
+            return;
+        uint64_t ticks = rdtsc() - t.start;
+        OpTrace &o = t.trace.ops[t.op];
+        o.latency.record(ticks);
+        if (t.visits > 0) {
+            o.depth[std::min(t.visits - 1, TRACE_MAX_DEPTH - 1)]++;
+            o.itype[t.itype]++;
+        }
+        if (t.events) {
+            o.rebuild_latency.record(ticks);
+            o.path_rebuilds += (t.events & TEV_PathRebuild) ? 1 : 0;
+            o.cnode_rebulks += (t.events & TEV_CnodeRebulk) ? 1 : 0;
+        }
+        t.op = -1;
+    }
+};
+
+/**
+ * Record one visited item of the operation in progress, the last one is the
+ * terminal item.
+ */
+inline void traceVisit(const int itype) {
+    ThreadTrace &t = threadTrace();
+    t.visits++;
+    t.itype = itype & (TRACE_ITYP_NUM - 1);
+}
+
+/**
+ * Record a structural event of the operation in progress.
+ */
+inline void traceEvent(const TraceEvent ev) { threadTrace().events |= ev; }
+
+/**
+ * Return the merged trace of all the threads. Traces of live threads are read
+ * without stopping them, so call it when the workers are quiescent for exact
+ * numbers.
+ */
+inline Trace traceSnapshot() {
+    TraceRegistry &r = TraceRegistry::get();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    Trace all = r.retired;
+    for (Trace *t : r.live)
+        all.merge(*t);
+    return all;
+}
+
+/**
+ * Clear the traces of all the threads.
+ */
+inline void traceReset() {
+    TraceRegistry &r = TraceRegistry::get();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    r.retired.reset();
+    for (Trace *t : r.live)
+        t->reset();
+}
+
+}; // namespace lits
@@ -3,6 +3,9 @@
 #include "lits_base.hpp"
 #include "lits_gpkl.hpp"
 
+#include <sys/time.h>
+#include <time.h>
+
 namespace lits {
 
 /**
@@ -19,16 +22,50 @@ inline bool checkSortedUnique(const str *keys, const int len) {
 }
 
 /**
- * A simple inline hash function for string without go through all bytes.
+ * A fast hash function over all the bytes of a string with known length.
+ *
+ * Eight bytes are mixed per step, so a short key costs a few multiplies. The
+ * result is stored in the kv header, and its upper 16 bits are the fingerprint
+ * used by Cnode (see fingerprint()).
  */
-inline uint16_t hashStr(const str key) {
-    uint16_t ret = ustrlen(key);
-    uint16_t c1 = key[ret / 2];
-    uint16_t c2 = key[2 * ret / 3];
-    uint16_t c3 = key[4 * ret / 5];
-    return ret ^ c1 ^ c2 ^ c3;
+inline uint32_t hashStr(const str key, const int len) {
+    static constexpr uint64_t M = 0xff51afd7ed558ccdUL;
+    uint64_t h = 0x9e3779b97f4a7c15UL ^ (uint64_t)len;
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        h = (h ^ str_load64(key + i)) * M;
+        h ^= h >> 32;
+    }
+    if (i < len) {
+        uint64_t w = 0;
+        memcpy(&w, key + i, len - i);
+        h = (h ^ w) * M;
+    }
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53UL;
+    h ^= h >> 33;
+    return (uint32_t)h;
 }
 
+/**
+ * Return the 16-bit fingerprint of a key hash.
+ */
+inline uint16_t fingerprint(const uint32_t hash) { return hash >> 16; }
+
+/**
+ * The length and hash of a key. An operation computes it at most once and
+ * passes it down to every place which needs either of them.
+ */
+class KeyMeta {
+  public:
+    uint32_t len;
+    uint32_t hash;
+
+    KeyMeta() = default;
+    KeyMeta(const str key) : len(ustrlen(key)), hash(hashStr(key, len)) {}
+    inline uint16_t fp() const { return fingerprint(hash); }
+};
+
 /**
  * Return the smallest 2**k which is bigger or equal than n.
  * Return 2 for 2
@@ -47,6 +84,15 @@ inline uint64_t quick2(uint64_t n) {
     return n;
 }
 
+/**
+ * Return the monotonic wall clock time in seconds.
+ */
+inline double nowSec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
 /**
  * Return a randomly generated uint64_t.
  */
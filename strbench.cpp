@@ -0,0 +1,136 @@
+#include "lits/lits_str.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+#define RESET "\033[0m"
+#define GREEN "\033[32m"
+#define YELLOW "\033[33m"
+
+// Pairs of strings per length, and rounds over all the pairs
+const int default_pair_cnt = 4096;
+const int default_round_cnt = 200;
+
+// Key lengths to be measured
+const int key_lens[] = {8, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+
+typedef int (*cpl_fn)(const char *, const char *);
+typedef int (*len_fn)(const char *);
+typedef int (*ncmp_fn)(const char *, const char *, const int);
+
+typedef struct {
+    const char *name;
+    len_fn len;
+    cpl_fn cpl;
+    cpl_fn cmp;
+    ncmp_fn ncmp;
+} tier;
+
+const tier tiers[] = {
+    {"scalar", lits::str_scalar_len, lits::str_scalar_cpl, lits::str_scalar_cmp,
+     lits::str_scalar_ncmp},
+    {"word", lits::str_word_len, lits::str_word_cpl, lits::str_word_cmp,
+     lits::str_word_ncmp},
+#ifdef LITS_STR_X86
+    {"sse4.2", lits::str_sse42_len, lits::str_sse42_cpl, lits::str_sse42_cmp,
+     lits::str_sse42_ncmp},
+    {"avx2", lits::str_avx2_len, lits::str_avx2_cpl, lits::str_avx2_cmp,
+     lits::str_avx2_ncmp},
+#endif
+};
+
+// All strings are stored in one buffer, same as the testbench
+std::vector<char> buffer;
+std::vector<const char *> lhs, rhs;
+
+/**
+ * Generate pairs of strings of length len which only differ in the last byte,
+ * which is the worst case for all the primitives.
+ */
+void preparePairs(int len) {
+    buffer.assign((size_t)default_pair_cnt * 2 * (len + 1), 0);
+    lhs.clear();
+    rhs.clear();
+    char *p = buffer.data();
+    for (int i = 0; i < default_pair_cnt; ++i) {
+        char *a = p, *b = p + len + 1;
+        for (int j = 0; j < len; ++j) {
+            a[j] = b[j] = 'a' + rand() % 26;
+        }
+        b[len - 1] = a[len - 1] + 1;
+        lhs.push_back(a);
+        rhs.push_back(b);
+        p += 2 * (len + 1);
+    }
+}
+
+double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * Return the average nanoseconds per call.
+ */
+template <class F> double measure(F f, uint64_t &checkSum) {
+    double t1 = now();
+    for (int r = 0; r < default_round_cnt; ++r) {
+        for (int i = 0; i < default_pair_cnt; ++i) {
+            checkSum += f(i);
+        }
+    }
+    double t2 = now();
+    return (t2 - t1) * 1e9 / ((double)default_round_cnt * default_pair_cnt);
+}
+
+int main() {
+    srand(time(NULL));
+    uint64_t checkSum = 0;
+
+    std::cout << YELLOW << "[String Primitives] (ns/op, " << default_pair_cnt
+              << " pairs x " << default_round_cnt << " rounds)" << RESET
+              << std::endl;
+    std::cout << "[Info]: Dispatched tier: " << GREEN
+              << tiers[lits::str_isa].name << RESET << std::endl;
+
+    for (const char *op : {"ustrlen", "ucpl", "ustrcmp", "ustrcmp(len)"}) {
+        std::cout << std::endl << "[" << op << "]" << std::endl;
+        std::cout << std::setw(8) << "len";
+        for (const tier &t : tiers) {
+            std::cout << std::setw(10) << t.name;
+        }
+        std::cout << std::endl;
+
+        for (int len : key_lens) {
+            preparePairs(len);
+            std::cout << std::setw(8) << len;
+            for (const tier &t : tiers) {
+                double ns;
+                if (op == std::string("ustrlen")) {
+                    ns = measure([&](int i) { return t.len(lhs[i]); },
+                                 checkSum);
+                } else if (op == std::string("ucpl")) {
+                    ns = measure([&](int i) { return t.cpl(lhs[i], rhs[i]); },
+                                 checkSum);
+                } else if (op == std::string("ustrcmp")) {
+                    ns = measure([&](int i) { return t.cmp(lhs[i], rhs[i]); },
+                                 checkSum);
+                } else {
+                    ns = measure(
+                        [&](int i) { return t.ncmp(lhs[i], rhs[i], len); },
+                        checkSum);
+                }
+                std::cout << std::setw(10) << std::fixed
+                          << std::setprecision(2) << ns;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    std::cout << std::endl << "[Info]: Checksum:\t" << checkSum << std::endl;
+    return 0;
+}
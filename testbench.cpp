@@ -1,12 +1,14 @@
 #include "genId.hpp"
 
-#include "lits/lits.hpp"
+#include "lits/lits_sharded.hpp"
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <random>
 #include <string>
 #include <sys/time.h>
+#include <thread>
 #include <vector>
 
 #define RESET "\033[0m"
@@ -15,17 +17,16 @@
 #define YELLOW "\033[33m"
 #define BLUE "\033[34m"
 
-typedef enum {
-    idcards = 0,
-    randstr = 1,
-} strType;
-
-// Randomly generated keys (idcard)
+// Randomly generated (or loaded) keys, and the values of a key file if any
 std::vector<std::string> keys;
+std::vector<uint64_t> key_vals;
 const int default_key_cnt = 2e6;
+int num_of_keys = default_key_cnt;
 const int default_search_cnt = 1e6;
 const int default_scan_cnt = 1e5;
 const int default_scan_range = 100;
+const double default_zipf_theta = 0.99;
+const int default_cache_bytes = 256 << 10;
 
 // std::string will store strings with a length less than 16 locally. To ensure
 // unified memory access for the data, we store all the data in a buffer.
@@ -47,32 +48,90 @@ char **insert_keys;
 uint64_t dummy_value = 982;
 int num_of_insert;
 
-void generateKeys(strType t) {
-    keys = IdGenerator::getKeys(default_key_cnt, t);
+// The hardware counters of the benchmark thread (timing only if unavailable)
+lits::PerfCounters perf;
+
+// The threads of the concurrent test
+const int default_thread_cnt = 8;
+
+// The failed checks of the correctness tests
+int num_of_failures = 0;
+
+void Check(bool ok, const std::string &what) {
+    std::cout << "[Check]: " << what << ":\t"
+              << (ok ? GREEN "passed" RESET : RED "FAILED" RESET) << std::endl;
+    if (!ok)
+        num_of_failures++;
+}
+
+// The keys and values an index must hold
+typedef std::map<std::string, uint64_t> Reference;
+
+/**
+ * Check the index against the reference: its number of keys, a full scan
+ * in key order, a lookup of every key, and that the keys of gone are not
+ * found.
+ */
+void CheckIndex(lits::LITS &index, const Reference &ref,
+                const std::string &what,
+                const std::vector<std::string> &gone = {}) {
+    bool scanned = true;
+    uint64_t n = 0;
+    auto it = ref.begin();
+    for (auto iter = index.begin(); iter.valid() && iter.not_finish();
+         iter.next(), ++n) {
+        lits::kv *e = iter.getKV();
+        scanned &= it != ref.end() && it->first == std::string(e->k, e->len) &&
+                   it->second == e->read();
+        if (it != ref.end())
+            ++it;
+    }
+
+    bool found = true;
+    for (auto &p : ref) {
+        lits::kv *e = index.lookup(p.first.c_str());
+        found &= e && e->read() == p.second;
+    }
+    for (auto &k : gone) {
+        found &= index.lookup(k.c_str()) == NULL || ref.count(k);
+    }
+
+    Check(n == ref.size() && index.stats().num_keys == ref.size(),
+          what + ": key count");
+    Check(scanned, what + ": full scan");
+    Check(found, what + ": lookups");
+}
+
+bool generateKeys(const char *name) {
+    if (!loadDataset(name, num_of_keys, keys, key_vals))
+        return false;
+    KeyStats(keys).print();
+    return true;
 }
 
-void _Myfree(void *&addr) {
+// The arrays are allocated by new[]
+template <class T> void _Myfree(T *&addr) {
     if (addr) {
-        free(addr);
+        delete[] addr;
         addr = NULL;
     }
 }
 
 void freeData() {
-    _Myfree((void *&)bulk_data);
-    _Myfree((void *&)bulk_keys);
-    _Myfree((void *&)bulk_vals);
-    _Myfree((void *&)search_data);
-    _Myfree((void *&)search_keys);
-    _Myfree((void *&)insert_data);
-    _Myfree((void *&)insert_keys);
+    _Myfree(bulk_data);
+    _Myfree(bulk_keys);
+    _Myfree(bulk_vals);
+    _Myfree(search_data);
+    _Myfree(search_keys);
+    _Myfree(insert_data);
+    _Myfree(insert_keys);
 }
 
 void prepareSearchQuerys() {
     std::cout << "[Info]: Preparing search queries ..." << std::endl;
 
     // Prepare 20M keys (100% bulk load)
-    int key_cnt = default_key_cnt;
+    int key_cnt = keys.size();
     uint64_t bulk_byte_size = 0, bulk_ofs = 0;
     uint64_t search_byte_size = 0, search_ofs = 0;
 
@@ -91,7 +150,7 @@ void prepareSearchQuerys() {
     // Copy the data
     for (int i = 0; i < keys.size(); ++i) {
         bulk_keys[i] = bulk_data + bulk_ofs;
-        bulk_vals[i] = i + 1;
+        bulk_vals[i] = key_vals.empty() ? i + 1 : key_vals[i];
         memcpy(bulk_data + bulk_ofs, keys[i].c_str(), keys[i].length() + 1);
         bulk_ofs += keys[i].length() + 1;
     }
@@ -102,7 +161,7 @@ void prepareSearchQuerys() {
     std::random_shuffle(keys.begin(), keys.end());
 
     // Prepare the search key number
-    num_of_search = default_search_cnt;
+    num_of_search = std::min<int>(default_search_cnt, keys.size());
 
     for (int i = 0; i < num_of_search; i++) {
         search_byte_size += keys[i].length() + 1;
@@ -122,11 +181,13 @@ void prepareSearchQuerys() {
     assert(search_ofs == search_byte_size);
 }
 
-void prepareInsertQuerys() {
+// If sequential, the inserted keys are all greater than the bulk loaded ones,
+// and inserted in ascending order
+void prepareInsertQuerys(bool sequential = false) {
     std::cout << "[Info]: Preparing insert queries ..." << std::endl;
 
     // Prepare 20M keys (50% bulk load, 50% insert)
-    int key_cnt = default_key_cnt;
+    int key_cnt = keys.size();
     uint64_t bulk_byte_size = 0, bulk_ofs = 0;
     uint64_t insert_byte_size = 0, insert_ofs = 0;
 
@@ -134,11 +195,16 @@ void prepareInsertQuerys() {
     num_of_bulk = key_cnt / 2;
     num_of_insert = key_cnt / 2;
 
-    // Randomly shuffle the keys
-    std::random_shuffle(keys.begin(), keys.end());
+    if (sequential) {
+        std::sort(keys.begin(), keys.end());
+    } else {
+        // Randomly shuffle the keys
+        std::random_shuffle(keys.begin(), keys.end());
 
-    // Sort the 50% keys for bulk load
-    std::partial_sort(keys.begin(), keys.begin() + num_of_bulk, keys.end());
+        // Sort the 50% keys for bulk load
+        std::partial_sort(keys.begin(), keys.begin() + num_of_bulk,
+                          keys.end());
+    }
 
     for (int i = 0; i < num_of_bulk; i++) {
         bulk_byte_size += keys[i].length() + 1;
@@ -173,11 +239,23 @@ void prepareInsertQuerys() {
     }
 }
 
+void prepareSkewedQuerys() {
+    prepareSearchQuerys();
+
+    // Point the search queries at zipfian picked bulk loaded keys, the
+    // popular ones scattered over the key space
+    Rand rnd(1);
+    Zipfian zipf(num_of_bulk, default_zipf_theta);
+    for (int i = 0; i < num_of_search; ++i) {
+        search_keys[i] = bulk_keys[scramble(zipf.next(rnd), num_of_bulk)];
+    }
+}
+
 void prepareScanQuerys() {
     std::cout << "[Info]: Preparing scan queries ..." << std::endl;
 
     // Prepare 20M keys (100% bulk load)
-    int key_cnt = default_key_cnt;
+    int key_cnt = keys.size();
     uint64_t bulk_byte_size = 0, bulk_ofs = 0;
     uint64_t search_byte_size = 0, search_ofs = 0;
 
@@ -196,7 +274,7 @@ void prepareScanQuerys() {
     // Copy the data
     for (int i = 0; i < keys.size(); ++i) {
         bulk_keys[i] = bulk_data + bulk_ofs;
-        bulk_vals[i] = i + 1;
+        bulk_vals[i] = key_vals.empty() ? i + 1 : key_vals[i];
         memcpy(bulk_data + bulk_ofs, keys[i].c_str(), keys[i].length() + 1);
         bulk_ofs += keys[i].length() + 1;
     }
@@ -207,7 +285,7 @@ void prepareScanQuerys() {
     std::random_shuffle(keys.begin(), keys.end());
 
     // Prepare the search key number
-    num_of_search = default_scan_cnt;
+    num_of_search = std::min<int>(default_scan_cnt, keys.size());
 
     for (int i = 0; i < num_of_search; i++) {
         search_byte_size += keys[i].length() + 1;
@@ -227,11 +305,17 @@ void prepareScanQuerys() {
     assert(search_ofs == search_byte_size);
 }
 
-void OutputResult(uint64_t checkSum, int numQuery, double second) {
+void OutputResult(uint64_t checkSum, int numQuery, double second,
+                  const lits::PerfSample &pc) {
     std::cout << "[Info]: Checksum:\t" << checkSum << std::endl;
     std::cout << "[Info]: Query Count:\t" << numQuery << std::endl;
     std::cout << "[Info]: Throughput:\t\033[32m" << numQuery / (1e6 * second)
               << " Mops\033[0m" << std::endl;
+    pc.print(std::cout, numQuery);
+#ifdef LITS_TRACE
+    lits::traceSnapshot().print();
+    lits::traceReset();
+#endif
 }
 
 void LITS_Search_test() {
@@ -248,6 +332,7 @@ void LITS_Search_test() {
 
     std::cout << "[Info]: Index bulk loaded." << std::endl;
 
+    lits::PerfSample pc1 = perf.read();
     gettimeofday(&tv1, NULL);
 
     for (int i = 0; i < num_of_search; ++i) {
@@ -255,10 +340,11 @@ void LITS_Search_test() {
     }
 
     gettimeofday(&tv2, NULL);
+    lits::PerfSample pc2 = perf.read();
 
     second = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
 
-    OutputResult(checkSum, num_of_search, second);
+    OutputResult(checkSum, num_of_search, second, pc2 - pc1);
 
     index.destroy();
 }
@@ -277,6 +363,7 @@ void LITS_Insert_test() {
 
     std::cout << "[Info]: Index bulk loaded." << std::endl;
 
+    lits::PerfSample pc1 = perf.read();
     gettimeofday(&tv1, NULL);
 
     for (int i = 0; i < num_of_insert; ++i) {
@@ -285,10 +372,93 @@ void LITS_Insert_test() {
     }
 
     gettimeofday(&tv2, NULL);
+    lits::PerfSample pc2 = perf.read();
 
     second = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
 
-    OutputResult(checkSum, num_of_insert, second);
+    OutputResult(checkSum, num_of_insert, second, pc2 - pc1);
+
+    index.destroy();
+}
+
+/**
+ * Bulk load the bulk keys and insert the insert keys in order, with the
+ * append cursor enabled or not, and return the seconds of the inserts.
+ */
+double TimeAppends(bool cursor, uint64_t &checkSum, lits::PerfSample &pc) {
+    lits::LITS index;
+    index.set_append_cursor(cursor);
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+
+    checkSum = 0;
+    lits::PerfSample pc1 = perf.read();
+    double t0 = lits::nowSec();
+
+    for (int i = 0; i < num_of_insert; ++i) {
+        checkSum +=
+            index.insert((const char *)(insert_keys[i]), dummy_value) ? 1 : 0;
+    }
+
+    double second = lits::nowSec() - t0;
+    pc = perf.read() - pc1;
+
+    index.destroy();
+    return second;
+}
+
+void LITS_Sequential_test() {
+    uint64_t checkSum = 0, plainSum = 0;
+    lits::PerfSample pc, plain_pc;
+
+    // Alternate the passes with and without the cursor, and keep the best
+    // of each, against the noise of the machine
+    double second = DBL_MAX, plain = DBL_MAX;
+    for (int round = 0; round < 2; ++round) {
+        plain = std::min(plain, TimeAppends(false, plainSum, plain_pc));
+        second = std::min(second, TimeAppends(true, checkSum, pc));
+    }
+
+    OutputResult(checkSum, num_of_insert, second, pc);
+    std::cout << "[Info]: Without cursor:\t\033[32m"
+              << num_of_insert / (1e6 * plain) << " Mops\033[0m ("
+              << plain / second << "x slower)" << std::endl;
+    Check(plainSum == checkSum, "Sequential: inserts agree without cursor");
+
+    // Append again, checked against a reference: every 97th appended key is
+    // removed, and every 89th append is followed by an upsert of a bulk
+    // loaded key, both of which drop the kept path
+    lits::LITS index;
+    Reference ref;
+    std::vector<std::string> gone;
+    bool agreed = true;
+
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+    for (int i = 0; i < num_of_bulk; ++i)
+        ref.emplace(bulk_keys[i], bulk_vals[i]);
+
+    for (int i = 0; i < num_of_insert; ++i) {
+        std::string k = insert_keys[i];
+        agreed &=
+            index.insert(k.c_str(), i + 1) == ref.emplace(k, i + 1).second;
+        if (i % 97 == 0) {
+            agreed &= index.remove(k.c_str()) == (ref.erase(k) == 1);
+            gone.push_back(k);
+        }
+        if (i % 89 == 0) {
+            std::string u = bulk_keys[(i * 31) % num_of_bulk];
+            auto it = ref.find(u);
+            uint64_t old = it == ref.end() ? 0 : it->second;
+            agreed &= index.upsert(u.c_str(), i + 5) == old;
+            ref[u] = i + 5;
+        }
+    }
+
+    index.stats().print();
+    Check(agreed, "Sequential: results of the writes");
+    Check(index.get_counters().appends > 0, "Sequential: appends resumed");
+    CheckIndex(index, ref, "Sequential", gone);
 
     index.destroy();
 }
@@ -307,10 +477,12 @@ void LITS_Scan_test() {
 
     std::cout << "[Info]: Index bulk loaded." << std::endl;
 
+    lits::PerfSample pc1 = perf.read();
     gettimeofday(&tv1, NULL);
 
     for (int i = 0; i < num_of_search; ++i) {
         int scan_range = rand() % default_scan_range + 1;
+        LITS_TRACE_SCOPE(lits::TOP_Scan);
         auto iter = index.find((const char *)(search_keys[i]));
         for (int i = 0; i < scan_range && iter.not_finish(); ++i) {
             checkSum += iter.getKV()->v;
@@ -319,40 +491,835 @@ void LITS_Scan_test() {
     }
 
     gettimeofday(&tv2, NULL);
+    lits::PerfSample pc2 = perf.read();
 
     second = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
 
-    OutputResult(checkSum, num_of_search, second);
+    OutputResult(checkSum, num_of_search, second, pc2 - pc1);
+
+    index.destroy();
+}
+
+void OutputPhases(const lits::BulkloadPhases &phases, int numKeys) {
+    std::cout << "[Info]: Validate:\t" << phases.validate << " s" << std::endl;
+    std::cout << "[Info]: HPT Train:\t" << phases.train << " s" << std::endl;
+    std::cout << "[Info]: PMSS Init:\t" << phases.pmss_init << " s"
+              << std::endl;
+    std::cout << "[Info]: PMSS Bulk:\t" << phases.build << " s (GPKL "
+              << phases.gpkl << " s)" << std::endl;
+    std::cout << "[Info]: Sub-tries:\tmodel " << phases.model_nodes
+              << ", HOT " << phases.hot_subtries << ", Cnode "
+              << phases.cnodes << ", failed model " << phases.model_fails
+              << (phases.radix_root ? ", radix root" : "") << std::endl;
+    phases.validate_pc.print(std::cout, numKeys, "[Perf]: Validate: ");
+    phases.train_pc.print(std::cout, numKeys, "[Perf]: HPT Train: ");
+    phases.build_pc.print(std::cout, numKeys, "[Perf]: PMSS Bulk: ");
+    std::cout << "[Info]: Throughput:\t\033[32m"
+              << numKeys / (1e6 * phases.total()) << " Mops\033[0m"
+              << std::endl;
+}
+
+void LITS_Bulkload_test() {
+    // Scale the key count from 1M up to all the keys, sampling the sorted
+    // keys evenly so that every size keeps the key distribution
+    std::vector<int> sizes;
+    for (int n : {1000000, 2000000, 5000000, 10000000, 20000000, 50000000,
+                  100000000}) {
+        if (n < num_of_bulk)
+            sizes.push_back(n);
+    }
+    sizes.push_back(num_of_bulk);
+
+    std::vector<char *> sample_keys;
+    std::vector<uint64_t> sample_vals;
+    for (int n : sizes) {
+        sample_keys.resize(n);
+        sample_vals.resize(n);
+        for (int i = 0; i < n; ++i) {
+            int j = (int64_t)i * num_of_bulk / n;
+            sample_keys[i] = bulk_keys[j];
+            sample_vals[i] = bulk_vals[j];
+        }
+
+        // Bulk load once with the shared adjacent lcp table, once without
+        for (bool useAdjLCP : {true, false}) {
+            lits::LITS index;
+            index.set_adj_lcp(useAdjLCP);
+            index.set_perf_counters(&perf);
+
+            std::cout << "[Info]: Index bulk loading " << n << " keys ("
+                      << (useAdjLCP ? "shared adjacent lcp" : "rescanning gpkl")
+                      << ") ... " << std::endl;
+
+            index.bulkload((const char **)(sample_keys.data()),
+                           (const uint64_t *)(sample_vals.data()), n);
+
+            OutputPhases(index.bulkload_phases(), n);
+
+            index.destroy();
+        }
+    }
+}
+
+/**
+ * The sampled hash LITS used before keys carried a full hash: the length xor
+ * three bytes at len/2, 2*len/3 and 4*len/5.
+ */
+uint16_t sampledHash(const char *key) {
+    uint16_t ret = strlen(key);
+    uint16_t c1 = key[ret / 2];
+    uint16_t c2 = key[2 * ret / 3];
+    uint16_t c3 = key[4 * ret / 5];
+    return ret ^ c1 ^ c2 ^ c3;
+}
+
+void LITS_Fingerprint_test() {
+    // Sorted neighbours share a Cnode, so probe every key against the other
+    // keys of its CNODE_SIZE window and count the fingerprint collisions,
+    // each of which costs a wasted verify in _cnode_search.
+    std::vector<std::string> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<uint16_t> old_fp(sorted.size());
+    std::vector<uint16_t> new_fp(sorted.size());
+    for (int i = 0; i < sorted.size(); ++i) {
+        lits::KeyMeta meta((const lits::str)sorted[i].c_str());
+        old_fp[i] = sampledHash(sorted[i].c_str());
+        new_fp[i] = meta.fp();
+    }
+
+    uint64_t pairs = 0, old_fps = 0, new_fps = 0;
+    for (int l = 0; l + CNODE_SIZE <= sorted.size(); l += CNODE_SIZE) {
+        for (int i = l; i < l + CNODE_SIZE; ++i) {
+            for (int j = l; j < l + CNODE_SIZE; ++j) {
+                if (i == j)
+                    continue;
+                pairs++;
+                old_fps += old_fp[i] == old_fp[j];
+                new_fps += new_fp[i] == new_fp[j];
+            }
+        }
+    }
+
+    uint64_t probes = pairs / (CNODE_SIZE - 1);
+    std::cout << "[Info]: Compared Pairs:\t" << pairs << std::endl;
+    std::cout << "[Info]: Sampled Hash:\t" << 100.0 * old_fps / pairs
+              << "% false positive, " << (double)old_fps / probes
+              << " wasted verify per lookup" << std::endl;
+    std::cout << "[Info]: Full Hash:\t\033[32m" << 100.0 * new_fps / pairs
+              << "% false positive, " << (double)new_fps / probes
+              << " wasted verify per lookup\033[0m" << std::endl;
+}
+
+void LITS_Skewed_test() {
+    lits::LITS index;
+
+    std::cout << "[Info]: Index bulk loading ... " << std::endl;
+
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+
+    std::cout << "[Info]: Index bulk loaded." << std::endl;
+
+    // Search once without the lookup cache, once with it (starting cold)
+    for (int budget : {0, default_cache_bytes}) {
+        uint64_t checkSum = 0;
+        index.set_lookup_cache(budget);
+
+        std::cout << "[Info]: Lookup cache:\t" << budget << " bytes"
+                  << std::endl;
+
+        lits::PerfSample pc1 = perf.read();
+        double t0 = lits::nowSec();
+
+        for (int i = 0; i < num_of_search; ++i) {
+            checkSum += index.lookup((const char *)(search_keys[i])) ? 1 : 0;
+        }
+
+        double second = lits::nowSec() - t0;
+        lits::PerfSample pc2 = perf.read();
+
+        OutputResult(checkSum, num_of_search, second, pc2 - pc1);
+        if (budget)
+            index.cache_stats().print();
+    }
+
+    index.destroy();
+}
+
+void LITS_Memory_test() {
+    lits::LITS index;
+    uint64_t checkSum = 0;
+
+    std::cout << "[Info]: Index bulk loading ... " << std::endl;
+
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+    index.memory_breakdown().print(num_of_bulk);
+
+    std::cout << "[Info]: Inserting " << num_of_insert << " keys ... "
+              << std::endl;
+
+    for (int i = 0; i < num_of_insert; ++i) {
+        checkSum +=
+            index.insert((const char *)(insert_keys[i]), dummy_value) ? 1 : 0;
+    }
+    index.memory_breakdown().print(num_of_bulk + checkSum);
+
+    std::cout << "[Info]: Removing the inserted keys ... " << std::endl;
+
+    for (int i = 0; i < num_of_insert; ++i) {
+        checkSum -= index.remove((const char *)(insert_keys[i])) ? 1 : 0;
+    }
+    index.memory_breakdown().print(num_of_bulk + checkSum);
+
+    // Everything the index allocated must be freed by destroy
+    index.destroy();
+    std::cout << "[Info]: Bytes left after destroy:\t"
+              << index.get_counters().total_bytes() << std::endl;
+}
+
+void LITS_Concurrent_test() {
+    lits::ShardedLITS index;
+
+    std::cout << "[Info]: Index bulk loading into " << default_thread_cnt
+              << " shards ... " << std::endl;
+
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk, default_thread_cnt);
+
+    std::cout << "[Info]: Index bulk loaded." << std::endl;
+
+    // Every thread inserts its share of the keys, looking up and scanning
+    // the bulk loaded keys in between, so that the writers of all shards
+    // allocate and free HOT nodes at the same time
+    std::vector<int> inserted(default_thread_cnt, 0);
+    std::vector<int> misses(default_thread_cnt, 0);
+    std::vector<std::thread> threads;
+    double t0 = lits::nowSec();
+    for (int t = 0; t < default_thread_cnt; ++t) {
+        threads.emplace_back([&, t]() {
+            Rand rnd(t + 1);
+            for (int i = t; i < num_of_insert; i += default_thread_cnt) {
+                inserted[t] += index.insert(insert_keys[i], i + 1);
+                const char *k = bulk_keys[rnd.next() % num_of_bulk];
+                uint64_t v;
+                misses[t] += !index.lookup(k, v);
+                misses[t] += !index.scan(k, 10, [](lits::kv *) {});
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    double second = lits::nowSec() - t0;
+    std::cout << "[Info]: Throughput:\t\033[32m"
+              << 3 * num_of_insert / (1e6 * second) << " Mops\033[0m"
+              << std::endl;
+
+    int total = 0, missed = 0;
+    for (int t = 0; t < default_thread_cnt; ++t) {
+        total += inserted[t];
+        missed += misses[t];
+    }
+    Check(total == num_of_insert, "Concurrent inserts");
+    Check(missed == 0, "Concurrent lookups and scans");
+
+    // Every key holds its value afterwards, and a scan from the smallest
+    // key visits all of them in order
+    bool found = true;
+    const char *smallest = bulk_keys[0];
+    for (int i = 0; i < num_of_bulk; ++i) {
+        uint64_t v = 0;
+        found &= index.lookup(bulk_keys[i], v) && v == bulk_vals[i];
+    }
+    for (int i = 0; i < num_of_insert; ++i) {
+        uint64_t v = 0;
+        found &= index.lookup(insert_keys[i], v) && v == i + 1;
+        if (strcmp(insert_keys[i], smallest) < 0)
+            smallest = insert_keys[i];
+    }
+    Check(found, "Lookups after the inserts");
+
+    std::string prev;
+    bool ordered = true;
+    int scanned = index.scan(smallest, INT_MAX, [&](lits::kv *e) {
+        std::string k(e->k, e->len);
+        ordered &= prev < k;
+        prev = k;
+    });
+    Check(ordered && scanned == num_of_bulk + num_of_insert,
+          "Full scan after the inserts");
+
+    index.destroy();
+}
+
+// The number of model-based node builds and kv entry frees of the index,
+// either of which stales the find hints
+uint64_t HintEpoch(const lits::LITS &index) {
+    const lits::Counters &c = index.get_counters();
+    return c.model_builds + c.kv_frees;
+}
+
+/**
+ * Insert and upsert the insert keys, each with the hint of a find on the
+ * key of the index before it, and check every result against a reference.
+ * The written keys also include truncated and altered copies of the hint
+ * keys, which part from the hint inside a node prefix or land on a
+ * boundary slot. Some hints are made stale: by removing the key of the
+ * hint between the find and the write, by advancing the iterator, or by
+ * holding one across the rebuilds of many writes.
+ */
+void HintedWrites(bool radix) {
+    lits::LITS index;
+    Reference ref;
+    std::vector<std::string> gone;
+    bool agreed = true, resumed = false;
+    uint64_t stale = 0;
+
+    index.set_radix_root(radix);
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+    for (int i = 0; i < num_of_bulk; ++i)
+        ref.emplace(bulk_keys[i], bulk_vals[i]);
+    std::cout << "[Info]: Radix root:\t"
+              << (index.bulkload_phases().radix_root ? "yes" : "no")
+              << std::endl;
+
+    // Write the key with the hint, insert_hint on even i, else upsert_hint
+    auto write = [&](const lits::litsIter &hint, const std::string &k,
+                     int i) {
+        if (i % 2 == 0) {
+            agreed &= index.insert_hint(hint, k.c_str(), i + 1) ==
+                      ref.emplace(k, i + 1).second;
+            return;
+        }
+        auto it = ref.find(k);
+        uint64_t old = it == ref.end() ? 0 : it->second;
+        agreed &= index.upsert_hint(hint, k.c_str(), i + 1) == old;
+        ref[k] = i + 1;
+    };
+
+    // Write with a stale hint, which must not be resumed from
+    auto write_stale = [&](const lits::litsIter &hint, const std::string &k,
+                           int i) {
+        uint64_t hinted = index.get_counters().hinted;
+        write(hint, k, i);
+        resumed |= index.get_counters().hinted != hinted;
+        stale++;
+    };
+
+    const char *first = bulk_keys[0];
+    lits::litsIter held = index.find(first);
+    uint64_t held_epoch = HintEpoch(index);
+
+    for (int i = 0; i < num_of_insert; ++i) {
+        std::string k = insert_keys[i];
+
+        // The keys of the index around k. Every third hint is found on a
+        // bulk loaded key elsewhere instead, which shares no position with
+        // k past the bytes the models along the path read.
+        auto it = ref.lower_bound(k);
+        std::string near =
+            it == ref.begin() ? it->first : std::prev(it)->first;
+        std::string after = it == ref.end() ? "" : it->first;
+        if (i % 3 == 0)
+            near = bulk_keys[(i * 13) % num_of_bulk];
+        lits::litsIter hint = index.find(near.c_str());
+
+        if (i % 17 == 0 && ref.erase(near)) {
+            // Removing the key of the hint frees the entry it was found at
+            agreed &= index.remove(near.c_str());
+            gone.push_back(near);
+            write_stale(hint, k, i);
+        } else if (i % 19 == 0 && hint.valid() && hint.not_finish()) {
+            // The advanced iterator no longer records the path of its key
+            hint.next();
+            write_stale(hint, k, i);
+        } else {
+            write(hint, k, i);
+        }
+
+        // Part from the key of the hint at a byte j the key shares with the
+        // next key, likely inside the prefix of a node on the path, so that
+        // a raised copy lands on a boundary slot. Then, with the hint found
+        // on that copy, write a key parting from it at j + 1 (still inside
+        // that prefix). A truncated copy ends inside it.
+        if (i % 5 == 0 && ref.count(near)) {
+            int lcp = 0;
+            while (near[lcp] && near[lcp] == after[lcp])
+                lcp++;
+            hint = index.find(near.c_str());
+            write(hint, near.substr(0, lcp / 2), i + 1);
+            for (int j : {1, lcp / 2, lcp - 2}) {
+                if (j < 0 || j + 2 > lcp)
+                    continue;
+                std::string up = near, next = near.substr(0, j + 2);
+                up[j]++;
+                next[j]++;
+                next[j + 1] = next[j + 1] == '~' ? '}' : '~';
+                hint = index.find(near.c_str());
+                write(hint, up, i + 1);
+                hint = index.find(up.c_str());
+                write(hint, next, i);
+            }
+        }
+
+        // Re-upsert the key of the hint itself
+        if (i % 7 == 0) {
+            hint = index.find(near.c_str());
+            write(hint, near, 1);
+        }
+
+        // A hint held across the rebuilds of many writes
+        if (i % 1009 == 0) {
+            if (HintEpoch(index) != held_epoch)
+                write_stale(held, std::string(first) + "+", i);
+            else
+                write(held, std::string(first) + "+", i);
+            held = index.find(first);
+            held_epoch = HintEpoch(index);
+        }
+    }
+
+    std::string what = radix ? "Hints, radix root" : "Hints";
+    Check(agreed, what + ": results of the writes");
+    Check(index.get_counters().hinted > 0, what + ": hints resumed");
+    Check(stale > 0 && !resumed, what + ": stale hints not resumed");
+    CheckIndex(index, ref, what, gone);
+
+    index.destroy();
+}
+
+void LITS_Hint_test() {
+    HintedWrites(false);
+    HintedWrites(true);
+}
+
+/**
+ * Remove the keys of [lo, hi) from the reference, and return how many.
+ */
+uint64_t EraseRange(Reference &ref, const std::string &lo,
+                    const std::string &hi, std::vector<std::string> &gone) {
+    auto l = ref.lower_bound(lo), r = ref.lower_bound(hi);
+    uint64_t n = 0;
+    for (auto it = l; it != r; ++it, ++n) {
+        gone.push_back(it->first);
+    }
+    ref.erase(l, r);
+    return n;
+}
+
+void LITS_Remove_test() {
+    lits::LITS index;
+    Reference ref;
+    for (int i = 0; i < num_of_bulk; ++i) {
+        ref[bulk_keys[i]] = bulk_vals[i];
+    }
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+
+    // Ranges inside a leaf, over 1% and 20% of the keys, bounded by keys in
+    // and out of the index, and reaching past the last key
+    std::vector<std::string> gone;
+    std::vector<std::string> absent(insert_keys, insert_keys + num_of_insert);
+    std::sort(absent.begin(), absent.end());
+    int n = num_of_bulk;
+    std::vector<std::pair<std::string, std::string>> ranges = {
+        {bulk_keys[n / 10], bulk_keys[n / 10 + 3]},
+        {bulk_keys[n / 5], bulk_keys[n / 5 + n / 100]},
+        {absent[absent.size() / 2], absent[absent.size() * 7 / 10]},
+        {bulk_keys[n - n / 50], std::string(1, '\x7f')},
+    };
+    bool agreed = true;
+    double t0 = lits::nowSec();
+    uint64_t removed = 0;
+    for (auto &r : ranges) {
+        uint64_t m = index.remove_range(r.first.c_str(), r.second.c_str());
+        agreed &= m == EraseRange(ref, r.first, r.second, gone);
+        removed += m;
+    }
+    double second = lits::nowSec() - t0;
+    std::cout << "[Info]: Range removes:\t" << removed << " keys in "
+              << second << " s" << std::endl;
+    agreed &= index.remove_range(bulk_keys[n / 2], bulk_keys[n / 2]) == 0;
+    Check(agreed, "Range remove: keys removed");
+    CheckIndex(index, ref, "Range remove", gone);
+
+    // A sorted batch of every third key left, and of keys never inserted
+    std::vector<std::string> batch;
+    int i = 0;
+    for (auto &p : ref) {
+        if (i++ % 3 == 0)
+            batch.push_back(p.first);
+    }
+    batch.insert(batch.end(), absent.begin(), absent.begin() + n / 100);
+    std::sort(batch.begin(), batch.end());
+    std::vector<const char *> batch_keys;
+    uint64_t expected = 0;
+    for (auto &k : batch) {
+        batch_keys.push_back(k.c_str());
+        expected += ref.erase(k);
+        gone.push_back(k);
+    }
+    t0 = lits::nowSec();
+    removed = index.remove_sorted_batch(batch_keys.data(), batch_keys.size());
+    second = lits::nowSec() - t0;
+    std::cout << "[Info]: Batch remove:\t" << removed << " keys in " << second
+              << " s" << std::endl;
+    Check(removed == expected, "Batch remove: keys removed");
+    CheckIndex(index, ref, "Batch remove", gone);
+
+    // The trimmed index still takes inserts
+    for (int i = 0; i < (int)gone.size(); i += 2) {
+        index.insert(gone[i].c_str(), i + 1);
+        ref.emplace(gone[i], i + 1);
+    }
+    CheckIndex(index, ref, "Re-insert after removes", gone);
+
+    index.destroy();
+}
+
+/**
+ * Bulk load the sorted keys of ref into index, with the given model if any.
+ */
+void BulkloadReference(lits::LITS &index, const Reference &ref,
+                       lits::HPT *hpt = NULL) {
+    std::vector<const char *> keys;
+    std::vector<uint64_t> vals;
+    for (auto &p : ref) {
+        keys.push_back(p.first.c_str());
+        vals.push_back(p.second);
+    }
+    index.bulkload(keys.data(), vals.data(), keys.size(), hpt);
+}
+
+// The nodes (model-based, HOT and Cnodes) the index has built so far
+uint64_t NodeBuilds(const lits::LITS &index) {
+    const lits::Counters &c = index.get_counters();
+    return c.model_builds + c.hot_builds + c.cnode_builds;
+}
+
+/**
+ * Merge the index over theirs into the one over ours, and check the result
+ * against the merged reference. Return the nodes the merge built per node of
+ * the merged index.
+ */
+double MergeAndCheck(const Reference &ours, const Reference &theirs,
+                   lits::HPT *hpt, const lits::MergePolicy policy,
+                   const std::string &what) {
+    lits::LITS index, other;
+    BulkloadReference(index, ours, hpt);
+    BulkloadReference(other, theirs, hpt);
+
+    Reference ref = ours;
+    uint64_t expected = 0;
+    for (auto &p : theirs) {
+        auto res = ref.insert(p);
+        if (res.second)
+            ++expected;
+        else if (policy == lits::MERGE_TakeTheirs)
+            res.first->second = p.second;
+    }
+
+    uint64_t builds = NodeBuilds(index);
+    double t0 = lits::nowSec();
+    uint64_t added = index.merge(std::move(other), policy);
+    double second = lits::nowSec() - t0;
+    std::cout << "[Info]: " << what << ":\t" << added << " keys added in "
+              << second << " s, " << NodeBuilds(index) - builds << " of "
+              << NodeBuilds(other) << " nodes rebuilt" << std::endl;
+    Check(added == expected, what + ": keys added");
+    CheckIndex(index, ref, what);
+
+    double rebuilt = (double)(NodeBuilds(index) - builds) / NodeBuilds(other);
+    other.destroy();
+    index.destroy();
+    return rebuilt;
+}
+
+void LITS_Merge_test() {
+    int n = num_of_bulk;
+
+    // The keys under two first bytes, bulk loaded with a shared model: the
+    // keys of the other index all fall into the empty boundary slot after
+    // ours, where its root is grafted whole
+    Reference ours, theirs, all;
+    for (int i = 0; i < n; ++i) {
+        ours[std::string("a") + bulk_keys[i]] = bulk_vals[i];
+        theirs[std::string("b") + bulk_keys[i]] = bulk_vals[i];
+    }
+    all = ours;
+    all.insert(theirs.begin(), theirs.end());
+    std::vector<const char *> keys;
+    for (auto &p : all) {
+        keys.push_back(p.first.c_str());
+    }
+    lits::HPT *hpt = new lits::HPT();
+    hpt->train((const lits::str *)keys.data(), keys.size());
+    double rebuilt = MergeAndCheck(ours, theirs, hpt, lits::MERGE_KeepOurs,
+                                   "Merge disjoint (shared HPT)");
+    Check(rebuilt == 0, "Merge disjoint (shared HPT): root grafted");
+    delete hpt;
+
+    // Alternate blocks of keys, bulk loaded with a shared model: the
+    // sub-tries of the other index narrower than our slots are grafted, the
+    // others merged
+    ours.clear();
+    theirs.clear();
+    int block = n / 8;
+    for (int i = 0; i < n; ++i) {
+        (i / block % 2 ? theirs : ours)[bulk_keys[i]] = bulk_vals[i];
+    }
+    hpt = new lits::HPT();
+    hpt->train((const lits::str *)bulk_keys, n);
+    MergeAndCheck(ours, theirs, hpt, lits::MERGE_KeepOurs,
+                  "Merge blocks (shared HPT)");
+    delete hpt;
+
+    // Interleaved keys, and one key in ten in both indexes with another
+    // value: every sub-trie receives as many keys as it holds, and is
+    // rebuilt
+    ours.clear();
+    theirs.clear();
+    for (int i = 0; i < n; ++i) {
+        (i % 2 ? theirs : ours)[bulk_keys[i]] = bulk_vals[i];
+        if (i % 10 == 0)
+            theirs[bulk_keys[i]] = bulk_vals[i] + n;
+    }
+    rebuilt = MergeAndCheck(ours, theirs, NULL, lits::MERGE_KeepOurs,
+                            "Merge interleaved, keep ours");
+    Check(rebuilt > 0.5, "Merge interleaved: sub-tries rebuilt");
+    MergeAndCheck(ours, theirs, NULL, lits::MERGE_TakeTheirs,
+                  "Merge interleaved, take theirs");
+}
+
+/**
+ * Move the keys of ref not less than key into a new reference, and return it.
+ */
+Reference SplitReference(Reference &ref, const std::string &key) {
+    auto it = ref.lower_bound(key);
+    Reference right(it, ref.end());
+    ref.erase(it, ref.end());
+    return right;
+}
+
+std::vector<std::string> KeysOf(const Reference &ref) {
+    std::vector<std::string> keys;
+    for (auto &p : ref) {
+        keys.push_back(p.first);
+    }
+    return keys;
+}
+
+void LITS_Split_test() {
+    lits::LITS index;
+    Reference ref;
+    for (int i = 0; i < num_of_bulk; ++i) {
+        ref[bulk_keys[i]] = bulk_vals[i];
+    }
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+    for (int i = 0; i < num_of_insert; i += 4) {
+        index.insert(insert_keys[i], i + 1);
+        ref.emplace(insert_keys[i], i + 1);
+    }
+
+    // Split at a key in the index, then the right part at a key not in it
+    std::string key = ref.lower_bound(bulk_keys[num_of_bulk / 3])->first;
+    Reference right_ref = SplitReference(ref, key);
+    double t0 = lits::nowSec();
+    lits::LITS right = index.split(key.c_str());
+    double second = lits::nowSec() - t0;
+    std::cout << "[Info]: Split:\t" << right_ref.size() << " keys moved in "
+              << second << " s" << std::endl;
+    CheckIndex(index, ref, "Split, left part", KeysOf(right_ref));
+    CheckIndex(right, right_ref, "Split, right part", KeysOf(ref));
+
+    key = insert_keys[1];
+    Reference last_ref = SplitReference(right_ref, key);
+    lits::LITS last;
+    last = right.split(key.c_str());
+    CheckIndex(right, right_ref, "Split again, left part", KeysOf(last_ref));
+    CheckIndex(last, last_ref, "Split again, right part", KeysOf(right_ref));
+
+    // Each part takes inserts and removes on its own
+    std::vector<std::string> gone;
+    for (int i = 2; i < num_of_insert; i += 4) {
+        lits::LITS &part = insert_keys[i] < key ? right : last;
+        Reference &part_ref = insert_keys[i] < key ? right_ref : last_ref;
+        part.insert(insert_keys[i], i + 1);
+        part_ref.emplace(insert_keys[i], i + 1);
+    }
+    for (int i = 0; i < num_of_bulk; i += 5) {
+        if (bulk_keys[i] < key && right.remove(bulk_keys[i])) {
+            right_ref.erase(bulk_keys[i]);
+            gone.push_back(bulk_keys[i]);
+        }
+    }
+    CheckIndex(right, right_ref, "Writes after split, left part", gone);
+    CheckIndex(last, last_ref, "Writes after split, right part");
+
+    last.destroy();
+    right.destroy();
+    index.destroy();
+}
+
+void LITS_RadixRoot_test() {
+    lits::LITS index;
+    Reference ref;
+    for (int i = 0; i < num_of_bulk; ++i) {
+        ref[bulk_keys[i]] = bulk_vals[i];
+    }
+    index.set_radix_root(true);
+    index.bulkload((const char **)(bulk_keys), (const uint64_t *)(bulk_vals),
+                   num_of_bulk);
+    OutputPhases(index.bulkload_phases(), num_of_bulk);
+    CheckIndex(index, ref, "Radix root bulk load");
+
+    // Inserts, then removes, through the radix root if it was chosen
+    for (int i = 0; i < num_of_insert; ++i) {
+        index.insert(insert_keys[i], i + 1);
+        ref.emplace(insert_keys[i], i + 1);
+    }
+    CheckIndex(index, ref, "Radix root insert");
+
+    std::vector<std::string> gone;
+    for (int i = 0; i < num_of_bulk; i += 3) {
+        index.remove(bulk_keys[i]);
+        ref.erase(bulk_keys[i]);
+        gone.push_back(bulk_keys[i]);
+    }
+    CheckIndex(index, ref, "Radix root remove", gone);
+
+    index.destroy();
+}
+
+/**
+ * Copy the keys into allocations of their exact size, so that a sanitizer
+ * catches any read past a terminator.
+ */
+std::vector<char *> SeparateKeys(char **src, int n) {
+    std::vector<char *> keys;
+    for (int i = 0; i < n; ++i) {
+        int len = strlen(src[i]);
+        keys.push_back(new char[len + 1]);
+        memcpy(keys.back(), src[i], len + 1);
+    }
+    return keys;
+}
+
+void LITS_SeparateKeys_test() {
+    std::vector<char *> bulk = SeparateKeys(bulk_keys, num_of_bulk);
+    std::vector<char *> inserts = SeparateKeys(insert_keys, num_of_insert);
+    lits::LITS index;
+    Reference ref;
+    for (int i = 0; i < num_of_bulk; ++i) {
+        ref[bulk[i]] = bulk_vals[i];
+    }
+    index.bulkload((const char **)bulk.data(), (const uint64_t *)bulk_vals,
+                   num_of_bulk);
+
+    // Every operation takes the separately allocated keys
+    for (int i = 0; i < num_of_insert; ++i) {
+        index.insert(inserts[i], i + 1);
+        ref.emplace(inserts[i], i + 1);
+    }
+    bool found = true;
+    for (int i = 0; i < num_of_bulk; ++i) {
+        lits::kv *e = index.lookup(bulk[i]);
+        found &= e && e->read() == bulk_vals[i];
+    }
+    Check(found, "Separate keys: lookups of the bulk loaded keys");
+
+    // Keys ending inside the prefixes of the nodes they descend
+    std::vector<char *> prefixes;
+    for (int i = 0; i < num_of_bulk; i += 7) {
+        int len = strlen(bulk[i]);
+        for (int l : {len / 2, len - 1}) {
+            prefixes.push_back(new char[l + 1]);
+            memcpy(prefixes.back(), bulk[i], l);
+            prefixes.back()[l] = 0;
+            if (index.insert(prefixes.back(), i + 3))
+                ref.emplace(prefixes.back(), i + 3);
+        }
+    }
+    CheckIndex(index, ref, "Separate keys, inserted prefixes");
+
+    std::vector<std::string> gone;
+    for (int i = 0; i < num_of_insert; i += 3) {
+        index.upsert(inserts[i], i + 2);
+        ref[inserts[i]] = i + 2;
+    }
+    for (int i = 0; i < num_of_bulk; i += 3) {
+        index.remove(bulk[i]);
+        ref.erase(bulk[i]);
+        gone.push_back(bulk[i]);
+    }
+    CheckIndex(index, ref, "Separate keys", gone);
 
     index.destroy();
+    for (char *k : bulk) {
+        delete[] k;
+    }
+    for (char *k : inserts) {
+        delete[] k;
+    }
+    for (char *k : prefixes) {
+        delete[] k;
+    }
 }
 
 int main(int argc, char *argv[]) {
     srand(time(NULL));
 
-    if (argc != 3) {
+    if (argc != 3 && argc != 4) {
         std::cout << "Usage: " << std::endl;
-        std::cout << argv[0] << " idcards/randstr 1/2/3" << std::endl;
+        std::cout << argv[0]
+                  << " idcards/randstr/url/email/path/uuid/dna/file:<path> "
+                     "1/2/3/4/5/6/7/8/9/10/11/12/13/14/15 [num_keys]"
+                  << std::endl;
         return 0;
     }
 
+    if (argc == 4) {
+        num_of_keys = atoi(argv[3]);
+        if (num_of_keys < 2000) {
+            std::cout << "Invalid argument" << std::endl;
+            return 0;
+        }
+    }
+
     int testMode = atoi(argv[2]);
-    if (testMode < 1 || testMode > 3) {
+    if (testMode < 1 || testMode > 15) {
         std::cout << "1: Search-Only Test" << std::endl;
         std::cout << "2: Insert-Only Test" << std::endl;
         std::cout << "3: Scan-Only Test" << std::endl;
+        std::cout << "4: Bulkload Test" << std::endl;
+        std::cout << "5: Fingerprint Test" << std::endl;
+        std::cout << "6: Memory Test" << std::endl;
+        std::cout << "7: Skewed Search Test" << std::endl;
+        std::cout << "8: Sequential Insert Test" << std::endl;
+        std::cout << "9: Concurrent Test" << std::endl;
+        std::cout << "10: Hint Test" << std::endl;
+        std::cout << "11: Remove Test" << std::endl;
+        std::cout << "12: Merge Test" << std::endl;
+        std::cout << "13: Split Test" << std::endl;
+        std::cout << "14: Radix Root Test" << std::endl;
+        std::cout << "15: Separate Keys Test" << std::endl;
         return 0;
     }
 
-    if (strcmp(argv[1], "idcards") == 0)
-        generateKeys(idcards);
-    else if (strcmp(argv[1], "randstr") == 0)
-        generateKeys(randstr);
-    else {
+    if (!generateKeys(argv[1])) {
         std::cout << "Invalid argument" << std::endl;
         return 0;
     }
 
+    if (!perf.available()) {
+        std::cout << "[Info]: Perf counters unavailable, timing only"
+                  << std::endl;
+    }
+
     // Do Search Test
     if (testMode == 1) {
         std::cout << std::endl;
@@ -383,6 +1350,138 @@ int main(int argc, char *argv[]) {
         LITS_Scan_test();
     }
 
+    // Do Bulkload Test
+    if (testMode == 4) {
+        std::cout << std::endl;
+        std::cout << "\033[33m" << "[Bulkload Test] (100% bulk load, "
+                  << keys.size() << " keys)"
+                  << "\033[0m" << std::endl;
+        prepareSearchQuerys();
+        LITS_Bulkload_test();
+    }
+
+    // Do Fingerprint Test
+    if (testMode == 5) {
+        std::cout << std::endl;
+        std::cout << "\033[33m" << "[Fingerprint Test] (" << keys.size()
+                  << " keys, windows of " << CNODE_SIZE << ")"
+                  << "\033[0m" << std::endl;
+        LITS_Fingerprint_test();
+    }
+
+    // Do Memory Test
+    if (testMode == 6) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Memory Test] (50% bulk load, 50% insert, then remove)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_Memory_test();
+    }
+
+    // Do Skewed Search Test
+    if (testMode == 7) {
+        std::cout << std::endl;
+        std::cout << "\033[33m" << "[Skewed Search Test] (100% bulk load, "
+                  << default_search_cnt << " zipfian search, theta "
+                  << default_zipf_theta << ")"
+                  << "\033[0m" << std::endl;
+        prepareSkewedQuerys();
+        LITS_Skewed_test();
+    }
+
+    // Do Sequential Insert Test
+    if (testMode == 8) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Sequential Insert Test] (50% bulk load, 50% insert "
+                     "in ascending order after the bulk loaded keys, with "
+                     "and without the append cursor, then checked against a "
+                     "reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys(true);
+        LITS_Sequential_test();
+    }
+
+    // Do Concurrent Test
+    if (testMode == 9) {
+        std::cout << std::endl;
+        std::cout << "\033[33m" << "[Concurrent Test] (50% bulk load, 50% "
+                  << "insert by " << default_thread_cnt
+                  << " threads with lookups and scans)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_Concurrent_test();
+    }
+
+    // Do Hint Test
+    if (testMode == 10) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Hint Test] (50% bulk load, 50% insert and upsert with "
+                     "fresh and stale find hints, without and with a radix "
+                     "root, checked against a reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_Hint_test();
+    }
+
+    // Do Remove Test
+    if (testMode == 11) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Remove Test] (50% bulk load, range and sorted batch "
+                     "removes checked against a reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_Remove_test();
+    }
+
+    // Do Merge Test
+    if (testMode == 12) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Merge Test] (blocks grafted with a shared HPT, "
+                     "interleaved keys rebuilt, checked against a reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_Merge_test();
+    }
+
+    // Do Split Test
+    if (testMode == 13) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Split Test] (both parts of split indexes checked "
+                     "against a reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_Split_test();
+    }
+
+    // Do Radix Root Test
+    if (testMode == 14) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Radix Root Test] (bulk load with set_radix_root, "
+                     "inserts and removes checked against a reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_RadixRoot_test();
+    }
+
+    // Do Separate Keys Test
+    if (testMode == 15) {
+        std::cout << std::endl;
+        std::cout << "\033[33m"
+                  << "[Separate Keys Test] (every key in an allocation of its "
+                     "exact size, checked against a reference)"
+                  << "\033[0m" << std::endl;
+        prepareInsertQuerys();
+        LITS_SeparateKeys_test();
+    }
+
     // Free the data
     freeData();
+    return num_of_failures ? 1 : 0;
 }
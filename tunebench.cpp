@@ -0,0 +1,224 @@
+#include "genId.hpp"
+
+#include "lits/lits.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define RESET "\033[0m"
+#define GREEN "\033[32m"
+#define YELLOW "\033[33m"
+
+const int default_key_cnt = 2e6;
+const int default_search_cnt = 1e6;
+
+// The keys (shuffled), the first half is bulk loaded, the rest inserted
+std::vector<std::string> keys;
+std::vector<uint64_t> key_vals;
+
+// The sorted bulk load keys and values
+std::vector<const char *> bulk_keys;
+std::vector<uint64_t> bulk_vals;
+
+// The queries, as pointers into keys
+std::vector<const char *> search_keys;
+std::vector<const char *> insert_keys;
+
+/**
+ * The measurements of one policy.
+ */
+class Result {
+  public:
+    int cnode_size, scale_factor, ps_hash_len, fc_hash_len;
+    bool loaded = false;
+    double bulkload_seconds = 0;
+    double search_seconds = 0;
+    double insert_seconds = 0;
+    double bytes_per_key = 0;
+    uint64_t checksum = 0;
+
+    double search_mops() const {
+        return search_keys.size() / (1e6 * search_seconds);
+    }
+    double insert_mops() const {
+        return insert_keys.size() / (1e6 * insert_seconds);
+    }
+
+    // The throughput of the searches and inserts together
+    double mixed_mops() const {
+        return (search_keys.size() + insert_keys.size()) /
+               (1e6 * (search_seconds + insert_seconds));
+    }
+};
+
+template <class Policy> Result runPolicy() {
+    Result res;
+    res.cnode_size = Policy::cnode_size;
+    res.scale_factor = Policy::scale_factor;
+    res.ps_hash_len = Policy::ps_hash_len;
+    res.fc_hash_len = Policy::fc_hash_len;
+
+    std::cout << "[Info]: Running cnode " << res.cnode_size << ", scale "
+              << res.scale_factor << ", hash " << res.ps_hash_len << "/"
+              << res.fc_hash_len << " ..." << std::endl;
+
+    lits::BasicLITS<Policy> index;
+    double t0 = lits::nowSec();
+    if (!index.bulkload(bulk_keys.data(), bulk_vals.data(),
+                        bulk_keys.size())) {
+        std::cerr << "[Error]: Failed to bulk load" << std::endl;
+        return res;
+    }
+    double t1 = lits::nowSec();
+    for (const char *key : search_keys) {
+        lits::kv *_kv = index.lookup(key);
+        res.checksum += _kv ? _kv->read() : 0;
+    }
+    double t2 = lits::nowSec();
+    for (int i = 0; i < insert_keys.size(); ++i) {
+        res.checksum += index.insert(insert_keys[i], i + 1);
+    }
+    double t3 = lits::nowSec();
+
+    res.loaded = true;
+    res.bulkload_seconds = t1 - t0;
+    res.search_seconds = t2 - t1;
+    res.insert_seconds = t3 - t2;
+    res.bytes_per_key = (double)index.memory_usage() / keys.size();
+
+    index.destroy();
+    return res;
+}
+
+bool prepareQueries(const char *name, int cnt) {
+    if (!loadDataset(name, cnt, keys, key_vals))
+        return false;
+    KeyStats(keys).print();
+
+    std::mt19937_64 gen(1);
+    std::vector<int> perm(keys.size());
+    for (int i = 0; i < perm.size(); ++i)
+        perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), gen);
+
+    // Bulk load half of the keys, sorted, and insert the other half
+    int num_of_bulk = keys.size() / 2;
+    std::vector<int> bulk(perm.begin(), perm.begin() + num_of_bulk);
+    std::sort(bulk.begin(), bulk.end());
+    for (int i : bulk) {
+        bulk_keys.push_back(keys[i].c_str());
+        bulk_vals.push_back(key_vals.empty() ? i + 1 : key_vals[i]);
+    }
+    for (int i = num_of_bulk; i < perm.size(); ++i) {
+        insert_keys.push_back(keys[perm[i]].c_str());
+    }
+
+    // Search the bulk loaded keys
+    std::uniform_int_distribution<int> pick(0, num_of_bulk - 1);
+    for (int i = 0; i < default_search_cnt; ++i) {
+        search_keys.push_back(bulk_keys[pick(gen)]);
+    }
+    return true;
+}
+
+/**
+ * Print the policy of r.
+ */
+void printPolicy(const Result &r) {
+    std::cout << "cnode " << std::setw(2) << r.cnode_size << ", scale "
+              << r.scale_factor << ", hash " << r.ps_hash_len << "/"
+              << r.fc_hash_len;
+}
+
+/**
+ * Print the best policy by the metric f, the larger the better.
+ */
+template <class F>
+void OutputBest(const char *what, const std::vector<Result> &results, F f) {
+    const Result *best = NULL;
+    for (const Result &r : results) {
+        if (r.loaded && (best == NULL || f(r) > f(*best)))
+            best = &r;
+    }
+    if (best == NULL)
+        return;
+    std::cout << std::left << std::setw(8) << what << std::right << ": "
+              << GREEN;
+    printPolicy(*best);
+    std::cout << RESET << std::endl;
+}
+
+void OutputResults(const std::vector<Result> &results) {
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(2);
+
+    std::cout << std::endl
+              << YELLOW << "[Policies] (" << bulk_keys.size()
+              << " keys bulk loaded, " << search_keys.size() << " search, "
+              << insert_keys.size() << " insert)" << RESET << std::endl;
+    for (const Result &r : results) {
+        printPolicy(r);
+        if (!r.loaded) {
+            std::cout << ": failed to bulk load" << std::endl;
+            continue;
+        }
+        std::cout << ": bulk load " << std::setw(7) << r.bulkload_seconds * 1e3
+                  << " ms, search " << std::setw(6) << r.search_mops()
+                  << " Mops, insert " << std::setw(6) << r.insert_mops()
+                  << " Mops, " << std::setw(6) << r.bytes_per_key
+                  << " bytes/key (checksum " << r.checksum << ")"
+                  << std::endl;
+    }
+
+    std::cout << std::endl << YELLOW << "[Best]" << RESET << std::endl;
+    OutputBest("Search", results, [](const Result &r) {
+        return r.search_mops();
+    });
+    OutputBest("Insert", results, [](const Result &r) {
+        return r.insert_mops();
+    });
+    OutputBest("Memory", results, [](const Result &r) {
+        return -r.bytes_per_key;
+    });
+    OutputBest("Overall", results, [](const Result &r) {
+        return r.mixed_mops();
+    });
+    std::cout.flags(flags);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cout << "Usage: " << std::endl;
+        std::cout << argv[0]
+                  << " idcards/randstr/url/email/path/uuid/dna/file:<path> "
+                     "[num_keys]"
+                  << std::endl;
+        return 0;
+    }
+
+    int cnt = argc == 3 ? atoi(argv[2]) : default_key_cnt;
+    if (cnt < 2000 || !prepareQueries(argv[1], cnt)) {
+        std::cout << "Invalid argument" << std::endl;
+        return 0;
+    }
+
+    // Sweep each parameter around the default policy
+    using lits::LitsPolicy;
+    std::vector<Result> results;
+    results.push_back(runPolicy<lits::DefaultPolicy>());
+    results.push_back(runPolicy<LitsPolicy<4, 2, 5, 5>>());
+    results.push_back(runPolicy<LitsPolicy<8, 2, 5, 5>>());
+    results.push_back(runPolicy<LitsPolicy<32, 2, 5, 5>>());
+    results.push_back(runPolicy<LitsPolicy<16, 1, 5, 5>>());
+    results.push_back(runPolicy<LitsPolicy<16, 3, 5, 5>>());
+    results.push_back(runPolicy<LitsPolicy<16, 4, 5, 5>>());
+    results.push_back(runPolicy<LitsPolicy<16, 2, 3, 3>>());
+    results.push_back(runPolicy<LitsPolicy<16, 2, 4, 4>>());
+    results.push_back(runPolicy<LitsPolicy<16, 2, 6, 6>>());
+
+    OutputResults(results);
+}
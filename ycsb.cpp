@@ -0,0 +1,473 @@
+#include "genId.hpp"
+#include "lits/lits_sharded.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define RESET "\033[0m"
+#define GREEN "\033[32m"
+#define YELLOW "\033[33m"
+
+// The operations of a YCSB-style mix
+enum Op { OP_Read = 0, OP_Update, OP_Insert, OP_Scan, OP_RMW, OP_Num };
+
+const char *op_names[OP_Num] = {"read", "update", "insert", "scan", "rmw"};
+
+// The request distributions
+enum Dist { DIST_Uniform = 0, DIST_Zipfian, DIST_Latest };
+
+const char *dist_names[] = {"uniform", "zipfian", "latest"};
+
+/**
+ * The standard YCSB core workloads, as operation proportions.
+ */
+typedef struct {
+    char name;
+    double mix[OP_Num];
+    Dist dist;
+} workload;
+
+const workload workloads[] = {
+    {'A', {0.50, 0.50, 0, 0, 0}, DIST_Zipfian}, // update heavy
+    {'B', {0.95, 0.05, 0, 0, 0}, DIST_Zipfian}, // read mostly
+    {'C', {1.00, 0, 0, 0, 0}, DIST_Zipfian},    // read only
+    {'D', {0.95, 0, 0.05, 0, 0}, DIST_Latest},  // read latest
+    {'E', {0, 0, 0.05, 0.95, 0}, DIST_Zipfian}, // short ranges
+    {'F', {0.50, 0, 0, 0, 0.50}, DIST_Zipfian}, // read-modify-write
+};
+
+/**
+ * The benchmark configuration, set from the command line.
+ */
+class Config {
+  public:
+    workload wl = workloads[0];
+    bool dist_set = false;
+    int threads = 1;
+    int shards = 0; // 0: one per thread
+    int keys = 1000000;
+    double warmup = 1;
+    double duration = 5;
+    int scan_len = 100;
+    double theta = 0.99;
+    std::string dataset = "idcards";
+    std::string json;
+};
+
+Config cfg;
+
+// All the keys in insertion order: the loaded ones, then the insert pool
+std::vector<std::string> records;
+
+// The number of records claimed by the inserting threads
+std::atomic<uint64_t> claimed(0);
+
+// The number of records inserted: the records before it are all in the
+// index, so that reads and scans only pick existing ones
+std::atomic<uint64_t> inserted(0);
+
+// Whether each claimed record has been inserted
+std::unique_ptr<std::atomic<bool>[]> done;
+
+// The benchmark phase, read by the workers
+enum Phase { PH_Warmup = 0, PH_Run, PH_Stop };
+std::atomic<int> phase(PH_Warmup);
+
+lits::ShardedLITS db;
+
+// Keeps the values read alive
+std::atomic<uint64_t> sink(0);
+
+Zipfian zipf;
+
+/**
+ * Pick an existing record according to the distribution.
+ */
+inline uint64_t pickRecord(Rand &rnd) {
+    uint64_t n = std::min<uint64_t>(inserted.load(),
+                                    records.size());
+    switch (cfg.wl.dist) {
+    case DIST_Uniform:
+        return rnd.next() % n;
+    case DIST_Zipfian:
+        return scramble(zipf.next(rnd), n);
+    case DIST_Latest:
+    default: {
+        uint64_t z = std::min<uint64_t>(zipf.next(rnd), n - 1);
+        return n - 1 - z;
+    }
+    }
+}
+
+/**
+ * Mark record i inserted, and move the inserted count past every record
+ * done in a row. The flag is set before the count is read, and the count
+ * moved before the next flag is read, so one of two threads finishing
+ * adjacent records always sees the other.
+ */
+inline void publishRecord(uint64_t i) {
+    done[i] = true;
+    uint64_t n = inserted.load();
+    while (n < records.size() && done[n]) {
+        inserted.compare_exchange_weak(n, n + 1);
+    }
+}
+
+/**
+ * The per-thread results.
+ */
+class Result {
+  public:
+    lits::Histogram latency[OP_Num];
+    uint64_t found = 0;
+    uint64_t missed = 0;
+    uint64_t scanned = 0;
+};
+
+/**
+ * The worker: run the mix until the stop phase, recording only in the run
+ * phase.
+ */
+void worker(int tid, Result *res) {
+    Rand rnd(tid + 1);
+    double cdf[OP_Num];
+    double acc = 0;
+    for (int i = 0; i < OP_Num; ++i) {
+        acc += cfg.wl.mix[i];
+        cdf[i] = acc;
+    }
+
+    uint64_t checkSum = 0;
+    int ph;
+    while ((ph = phase.load(std::memory_order_relaxed)) != PH_Stop) {
+        double u = rnd.unit() * acc;
+        int op = 0;
+        while (op < OP_Num - 1 && u >= cdf[op])
+            op++;
+
+        uint64_t t0 = lits::rdtsc();
+        bool ok = true;
+        switch (op) {
+        case OP_Read: {
+            uint64_t v = 0;
+            ok = db.lookup(records[pickRecord(rnd)].c_str(), v);
+            checkSum += v;
+            break;
+        }
+        case OP_Update: {
+            ok = db.update(records[pickRecord(rnd)].c_str(),
+                           [&](uint64_t) { return rnd.next(); });
+            break;
+        }
+        case OP_Insert: {
+            uint64_t i = claimed.fetch_add(1, std::memory_order_relaxed);
+            if (i >= records.size()) {
+                // The insert pool runs out, read instead
+                uint64_t v = 0;
+                op = OP_Read;
+                ok = db.lookup(records[pickRecord(rnd)].c_str(), v);
+            } else {
+                ok = db.insert(records[i].c_str(), i);
+                publishRecord(i);
+            }
+            break;
+        }
+        case OP_Scan: {
+            int len = rnd.next() % cfg.scan_len + 1;
+            int n = db.scan(records[pickRecord(rnd)].c_str(), len,
+                            [&](lits::kv *e) { checkSum += e->read(); });
+            if (ph == PH_Run)
+                res->scanned += n;
+            break;
+        }
+        case OP_RMW: {
+            ok = db.update(records[pickRecord(rnd)].c_str(),
+                           [](uint64_t v) { return v + 1; });
+            break;
+        }
+        }
+        uint64_t t1 = lits::rdtsc();
+
+        if (ph == PH_Run) {
+            res->latency[op].record(t1 - t0);
+            if (ok)
+                res->found++;
+            else
+                res->missed++;
+        }
+    }
+
+    sink += checkSum;
+}
+
+void usage(const char *argv0) {
+    std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+    std::cout << "  --workload A-F    YCSB core workload (default A)"
+              << std::endl;
+    std::cout << "  --mix r,u,i,s,m   custom read/update/insert/scan/rmw "
+                 "proportions"
+              << std::endl;
+    std::cout << "  --dist D          uniform/zipfian/latest" << std::endl;
+    std::cout << "  --theta T         zipfian constant (default 0.99)"
+              << std::endl;
+    std::cout << "  --threads N       worker threads (default 1)" << std::endl;
+    std::cout << "  --shards N        index shards (default: one per thread)"
+              << std::endl;
+    std::cout << "  --keys N          bulk loaded keys (default 1000000)"
+              << std::endl;
+    std::cout << "  --warmup S        warmup seconds (default 1)" << std::endl;
+    std::cout << "  --duration S      measured seconds (default 5)"
+              << std::endl;
+    std::cout << "  --scan-len N      max scan length (default 100)"
+              << std::endl;
+    std::cout << "  --dataset D       idcards/randstr/url/email/path/uuid/dna"
+              << std::endl;
+    std::cout << "                    or file:<path> (default idcards)"
+              << std::endl;
+    std::cout << "  --json FILE       write the results as JSON ('-': stdout)"
+              << std::endl;
+}
+
+bool parseArgs(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return false;
+        }
+        std::string v = argv[++i];
+        if (arg == "--workload") {
+            char w = toupper(v[0]);
+            if (w < 'A' || w > 'F') {
+                std::cerr << "Invalid workload: " << v << std::endl;
+                return false;
+            }
+            Dist d = cfg.wl.dist;
+            cfg.wl = workloads[w - 'A'];
+            if (cfg.dist_set)
+                cfg.wl.dist = d;
+        } else if (arg == "--mix") {
+            std::stringstream ss(v);
+            std::string p;
+            cfg.wl.name = '-';
+            for (int k = 0; k < OP_Num; ++k) {
+                cfg.wl.mix[k] = std::getline(ss, p, ',') ? atof(p.c_str()) : 0;
+            }
+        } else if (arg == "--dist") {
+            int d = 0;
+            while (d < 3 && v != dist_names[d])
+                d++;
+            if (d == 3) {
+                std::cerr << "Invalid distribution: " << v << std::endl;
+                return false;
+            }
+            cfg.wl.dist = (Dist)d;
+            cfg.dist_set = true;
+        } else if (arg == "--theta") {
+            cfg.theta = atof(v.c_str());
+        } else if (arg == "--threads") {
+            cfg.threads = std::max(1, atoi(v.c_str()));
+        } else if (arg == "--shards") {
+            cfg.shards = atoi(v.c_str());
+        } else if (arg == "--keys") {
+            cfg.keys = atoi(v.c_str());
+        } else if (arg == "--warmup") {
+            cfg.warmup = atof(v.c_str());
+        } else if (arg == "--duration") {
+            cfg.duration = atof(v.c_str());
+        } else if (arg == "--scan-len") {
+            cfg.scan_len = std::max(1, atoi(v.c_str()));
+        } else if (arg == "--dataset") {
+            cfg.dataset = v;
+        } else if (arg == "--json") {
+            cfg.json = v;
+        } else {
+            usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Split the dataset into the bulk loaded keys and the insert pool, the pool
+ * is inserted in random order. Values of a key file go with their keys.
+ */
+bool prepareRecords(std::vector<std::string> &load,
+                    std::vector<uint64_t> &load_vals) {
+    std::vector<std::string> keys;
+    std::vector<uint64_t> vals;
+    if (!loadDataset(cfg.dataset, 2000000, keys, vals))
+        return false;
+    KeyStats(keys).print();
+
+    std::vector<int> perm(keys.size());
+    for (int i = 0; i < perm.size(); ++i)
+        perm[i] = i;
+    std::random_shuffle(perm.begin(), perm.end());
+    cfg.keys = std::min<int>(cfg.keys, keys.size());
+
+    // Loaded keys come first (in random order), so that "latest" prefers
+    // the inserted ones
+    records.resize(keys.size());
+    for (int i = 0; i < perm.size(); ++i)
+        records[i] = keys[perm[i]];
+    claimed = inserted = cfg.keys;
+    done.reset(new std::atomic<bool>[records.size()]);
+    for (int i = 0; i < records.size(); ++i)
+        done[i] = i < cfg.keys;
+
+    std::sort(perm.begin(), perm.begin() + cfg.keys);
+    load.resize(cfg.keys);
+    load_vals.resize(cfg.keys);
+    for (int i = 0; i < cfg.keys; ++i) {
+        load[i] = keys[perm[i]];
+        load_vals[i] = vals.empty() ? i + 1 : vals[perm[i]];
+    }
+    return true;
+}
+
+void outputJSON(std::ostream &os, Result &all, double seconds,
+                uint64_t memory) {
+    double tpn = lits::ticksPerNs();
+    uint64_t ops = 0;
+    for (int i = 0; i < OP_Num; ++i)
+        ops += all.latency[i].count();
+
+    os << "{" << std::endl;
+    os << "  \"workload\": \"" << cfg.wl.name << "\"," << std::endl;
+    os << "  \"mix\": [";
+    for (int i = 0; i < OP_Num; ++i)
+        os << (i ? ", " : "") << cfg.wl.mix[i];
+    os << "]," << std::endl;
+    os << "  \"distribution\": \"" << dist_names[cfg.wl.dist] << "\","
+       << std::endl;
+    os << "  \"theta\": " << cfg.theta << "," << std::endl;
+    os << "  \"dataset\": \"" << cfg.dataset << "\"," << std::endl;
+    os << "  \"keys\": " << cfg.keys << "," << std::endl;
+    os << "  \"threads\": " << cfg.threads << "," << std::endl;
+    os << "  \"shards\": " << db.num_shards() << "," << std::endl;
+    os << "  \"warmup_sec\": " << cfg.warmup << "," << std::endl;
+    os << "  \"duration_sec\": " << seconds << "," << std::endl;
+    os << "  \"ops\": " << ops << "," << std::endl;
+    os << "  \"throughput_mops\": " << ops / seconds / 1e6 << "," << std::endl;
+    os << "  \"found\": " << all.found << "," << std::endl;
+    os << "  \"missed\": " << all.missed << "," << std::endl;
+    os << "  \"scanned\": " << all.scanned << "," << std::endl;
+    os << "  \"memory_bytes\": " << memory << "," << std::endl;
+    os << "  \"latency_ns\": {";
+    bool first = true;
+    for (int i = 0; i < OP_Num; ++i) {
+        const lits::Histogram &h = all.latency[i];
+        if (h.count() == 0)
+            continue;
+        os << (first ? "" : ",") << std::endl;
+        first = false;
+        os << "    \"" << op_names[i] << "\": {\"count\": " << h.count()
+           << ", \"mean\": " << h.mean() / tpn
+           << ", \"p50\": " << h.percentile(0.5) / tpn
+           << ", \"p99\": " << h.percentile(0.99) / tpn
+           << ", \"p99.9\": " << h.percentile(0.999) / tpn
+           << ", \"p99.99\": " << h.percentile(0.9999) / tpn
+           << ", \"max\": " << h.maximum() / tpn << "}";
+    }
+    os << std::endl << "  }" << std::endl;
+    os << "}" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    srand(time(NULL));
+
+    if (!parseArgs(argc, argv))
+        return 0;
+
+    std::vector<std::string> load;
+    std::vector<uint64_t> vals;
+    if (!prepareRecords(load, vals))
+        return 0;
+
+    std::cout << YELLOW << "[YCSB " << cfg.wl.name << "] ("
+              << dist_names[cfg.wl.dist] << ", " << cfg.threads
+              << " threads, " << cfg.keys << " keys)" << RESET << std::endl;
+
+    // Bulk load the index
+    std::vector<const char *> keys(load.size());
+    for (int i = 0; i < load.size(); ++i) {
+        keys[i] = load[i].c_str();
+    }
+    std::cout << "[Info]: Index bulk loading ... " << std::endl;
+    if (!db.bulkload(keys.data(), vals.data(), keys.size(),
+                        cfg.shards ? cfg.shards : cfg.threads))
+        return 0;
+    std::cout << "[Info]: Index bulk loaded into " << db.num_shards()
+              << " shards." << std::endl;
+
+    zipf = Zipfian(cfg.keys, cfg.theta);
+    lits::ticksPerNs();
+
+    // Warm up, then measure
+    std::vector<Result> results(cfg.threads);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < cfg.threads; ++i) {
+        threads.emplace_back(worker, i, &results[i]);
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(cfg.warmup));
+    double t1 = lits::nowSec();
+    phase = PH_Run;
+    std::this_thread::sleep_for(std::chrono::duration<double>(cfg.duration));
+    phase = PH_Stop;
+    double t2 = lits::nowSec();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    // Aggregate the per-thread results
+    Result all;
+    for (Result &r : results) {
+        for (int i = 0; i < OP_Num; ++i)
+            all.latency[i].merge(r.latency[i]);
+        all.found += r.found;
+        all.missed += r.missed;
+        all.scanned += r.scanned;
+    }
+
+    double seconds = t2 - t1;
+    double tpn = lits::ticksPerNs();
+    uint64_t ops = 0;
+    for (int i = 0; i < OP_Num; ++i)
+        ops += all.latency[i].count();
+
+    std::cout << "[Info]: Throughput:\t" << GREEN << ops / (1e6 * seconds)
+              << " Mops" << RESET << std::endl;
+    for (int i = 0; i < OP_Num; ++i) {
+        const lits::Histogram &h = all.latency[i];
+        if (h.count() == 0)
+            continue;
+        std::cout << "[Info]: " << op_names[i] << ":\t" << h.count()
+                  << " ops, p50 " << h.percentile(0.5) / tpn << ", p99 "
+                  << h.percentile(0.99) / tpn << ", p99.9 "
+                  << h.percentile(0.999) / tpn << ", p99.99 "
+                  << h.percentile(0.9999) / tpn << " ns" << std::endl;
+    }
+
+    if (cfg.json == "-") {
+        outputJSON(std::cout, all, seconds, db.memory_usage());
+    } else if (!cfg.json.empty()) {
+        std::ofstream out(cfg.json);
+        outputJSON(out, all, seconds, db.memory_usage());
+        std::cout << "[Info]: Results written to " << cfg.json << std::endl;
+    }
+
+    db.destroy();
+    return 0;
+}